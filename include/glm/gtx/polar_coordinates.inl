@@ -1,8 +1,65 @@
 /// @ref gtx_polar_coordinates
 /// @file glm/gtx/polar_coordinates.inl
 
-namespace glm
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "../simd/trigonometric.h"
+
+namespace glm{
+namespace detail
 {
+#	if GLM_ARCH & GLM_ARCH_AVX2_BIT
+		std::size_t const polar_batch_width = 8;
+#	elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+		std::size_t const polar_batch_width = 4;
+#	else
+		std::size_t const polar_batch_width = 1;
+#	endif
+
+	// count must be a multiple of polar_batch_width
+	GLM_FUNC_QUALIFIER void euclidean_batch
+	(
+		float const * latitude,
+		float const * longitude,
+		std::size_t count,
+		float * x,
+		float * y,
+		float * z
+	)
+	{
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			for(std::size_t i = 0; i < count; i += 8)
+			{
+				glm_vec8 SinLat, CosLat, SinLon, CosLon;
+				glm_vec8_sincos(_mm256_loadu_ps(latitude + i), &SinLat, &CosLat);
+				glm_vec8_sincos(_mm256_loadu_ps(longitude + i), &SinLon, &CosLon);
+				_mm256_storeu_ps(x + i, _mm256_mul_ps(CosLat, SinLon));
+				_mm256_storeu_ps(y + i, SinLat);
+				_mm256_storeu_ps(z + i, _mm256_mul_ps(CosLat, CosLon));
+			}
+#		elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+			for(std::size_t i = 0; i < count; i += 4)
+			{
+				glm_vec4 SinLat, CosLat, SinLon, CosLon;
+				glm_vec4_sincos(_mm_loadu_ps(latitude + i), &SinLat, &CosLat);
+				glm_vec4_sincos(_mm_loadu_ps(longitude + i), &SinLon, &CosLon);
+				_mm_storeu_ps(x + i, _mm_mul_ps(CosLat, SinLon));
+				_mm_storeu_ps(y + i, SinLat);
+				_mm_storeu_ps(z + i, _mm_mul_ps(CosLat, CosLon));
+			}
+#		else
+			for(std::size_t i = 0; i < count; ++i)
+			{
+				float const CosLat(cos(latitude[i]));
+				x[i] = CosLat * sin(longitude[i]);
+				y[i] = sin(latitude[i]);
+				z[i] = CosLat * cos(longitude[i]);
+			}
+#		endif
+	}
+}//namespace detail
+
 	template <typename T, precision P>
 	GLM_FUNC_QUALIFIER tvec3<T, P> polar
 	(
@@ -34,4 +91,64 @@ namespace glm
 			cos(latitude) * cos(longitude));
 	}
 
+	GLM_FUNC_QUALIFIER void euclidean
+	(
+		float const * latitude,
+		float const * longitude,
+		std::size_t count,
+		float * x,
+		float * y,
+		float * z
+	)
+	{
+		std::size_t const Body(count - count % detail::polar_batch_width);
+		detail::euclidean_batch(latitude, longitude, Body, x, y, z);
+		if(Body == count)
+			return;
+
+		// Pad the tail to a full vector so it rounds exactly like the body
+		float Lat[8] = {0}, Lon[8] = {0}, X[8], Y[8], Z[8];
+		std::size_t const Tail(count - Body);
+		std::copy(latitude + Body, latitude + count, Lat);
+		std::copy(longitude + Body, longitude + count, Lon);
+		detail::euclidean_batch(Lat, Lon, detail::polar_batch_width, X, Y, Z);
+		std::copy(X, X + Tail, x + Body);
+		std::copy(Y, Y + Tail, y + Body);
+		std::copy(Z, Z + Tail, z + Body);
+	}
+
+	GLM_FUNC_QUALIFIER void euclideanParallel
+	(
+		float const * latitude,
+		float const * longitude,
+		std::size_t count,
+		float * x,
+		float * y,
+		float * z,
+		unsigned threads
+	)
+	{
+		// Below this a thread costs more than it saves
+		std::size_t const MinPerThread(1 << 16);
+
+		if(threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		std::size_t Per = std::max((count + threads - 1) / threads, MinPerThread);
+		// Ranges are whole multiples of 64 bytes from the caller's pointers, so
+		// threads never share an output cache line if x, y and z are 64 byte aligned
+		Per = (Per + 15) & ~static_cast<std::size_t>(15);
+
+		std::vector<std::thread> Workers;
+		std::size_t First = 0;
+		for(; count - First > Per; First += Per)
+		{
+			Workers.push_back(std::thread([=]()
+			{
+				euclidean(latitude + First, longitude + First, Per, x + First, y + First, z + First);
+			}));
+		}
+		euclidean(latitude + First, longitude + First, count - First, x + First, y + First, z + First);
+		for(std::size_t i = 0; i < Workers.size(); ++i)
+			Workers[i].join();
+	}
 }//namespace glm
@@ -60,7 +60,7 @@ GLM_FUNC_QUALIFIER glm_vec4 glm_vec1_fma(glm_vec4 a, glm_vec4 b, glm_vec4 c) {
 }
 
 GLM_FUNC_QUALIFIER glm_vec4 glm_vec4_fma(glm_vec4 a, glm_vec4 b, glm_vec4 c) {
-#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT && defined(__FMA__)
   return _mm_fmadd_ps(a, b, c);
 #else
   return glm_vec4_add(glm_vec4_mul(a, b), c);
@@ -443,6 +443,7 @@
 #endif
 
 #if GLM_ARCH & GLM_ARCH_AVX_BIT
+	typedef __m256		glm_vec8;
 	typedef __m256d		glm_dvec4;
 #endif
 
@@ -3,6 +3,115 @@
 
 #pragma once
 
+#include "common.h"
+
 #if GLM_ARCH & GLM_ARCH_SSE2_BIT
 
+/// sin and cos of four angles at once, Cephes sinf/cosf polynomials.
+/// The angle is reduced to [-pi/4, pi/4] with a three part Cody-Waite
+/// split of pi/4, so the result stays accurate for |x| <= 8192.
+/// Max absolute error is 2^-23 (about 1.2e-7) over that range.
+GLM_FUNC_QUALIFIER void glm_vec4_sincos(glm_vec4 x, glm_vec4* s, glm_vec4* c) {
+  glm_vec4 const sign_mask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  glm_vec4 sign_sin = _mm_and_ps(x, sign_mask);
+  x = _mm_andnot_ps(sign_mask, x);
+
+  // octant j, rounded up to even so that x - j * pi/4 is in [-pi/4, pi/4]
+  glm_ivec4 j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+  j = _mm_add_epi32(j, _mm_set1_epi32(1));
+  j = _mm_and_si128(j, _mm_set1_epi32(~1));
+  glm_vec4 const y = _mm_cvtepi32_ps(j);
+
+  // bit 2 of j flips the sign of sin, bit 2 of j - 2 (inverted) that of cos
+  // bit 1 of j swaps the two polynomials
+  sign_sin = _mm_xor_ps(sign_sin, _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+  glm_vec4 const sign_cos = _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)),
+                       _mm_set1_epi32(4)),
+      29));
+  glm_vec4 const poly_mask = _mm_castsi128_ps(_mm_cmpeq_epi32(
+      _mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+
+  x = glm_vec4_fma(y, _mm_set1_ps(-0.78515625f), x);
+  x = glm_vec4_fma(y, _mm_set1_ps(-2.4187564849853515625e-4f), x);
+  x = glm_vec4_fma(y, _mm_set1_ps(-3.77489497744594108e-8f), x);
+  glm_vec4 const z = _mm_mul_ps(x, x);
+
+  glm_vec4 pc = _mm_set1_ps(2.443315711809948e-5f);
+  pc = glm_vec4_fma(pc, z, _mm_set1_ps(-1.388731625493765e-3f));
+  pc = glm_vec4_fma(pc, z, _mm_set1_ps(4.166664568298827e-2f));
+  pc = _mm_mul_ps(pc, _mm_mul_ps(z, z));
+  pc = glm_vec4_fma(z, _mm_set1_ps(-0.5f), pc);
+  pc = _mm_add_ps(pc, _mm_set1_ps(1.f));
+
+  glm_vec4 ps = _mm_set1_ps(-1.9515295891e-4f);
+  ps = glm_vec4_fma(ps, z, _mm_set1_ps(8.3321608736e-3f));
+  ps = glm_vec4_fma(ps, z, _mm_set1_ps(-1.6666654611e-1f));
+  ps = glm_vec4_fma(_mm_mul_ps(ps, z), x, x);
+
+  glm_vec4 const sin0 = _mm_or_ps(_mm_and_ps(poly_mask, ps),
+                                  _mm_andnot_ps(poly_mask, pc));
+  glm_vec4 const cos0 = _mm_or_ps(_mm_and_ps(poly_mask, pc),
+                                  _mm_andnot_ps(poly_mask, ps));
+  *s = _mm_xor_ps(sin0, sign_sin);
+  *c = _mm_xor_ps(cos0, sign_cos);
+}
+
 #endif  // GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+
+/// FMA is a separate extension, -mavx2 alone does not enable it.
+GLM_FUNC_QUALIFIER glm_vec8 glm_vec8_fma(glm_vec8 a, glm_vec8 b, glm_vec8 c) {
+#if defined(__FMA__)
+  return _mm256_fmadd_ps(a, b, c);
+#else
+  return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+/// Eight lane version of glm_vec4_sincos, same polynomials and error.
+/// Without FMA the reduction rounds twice per step, still within 2^-23.
+GLM_FUNC_QUALIFIER void glm_vec8_sincos(glm_vec8 x, glm_vec8* s, glm_vec8* c) {
+  glm_vec8 const sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+  glm_vec8 sign_sin = _mm256_and_ps(x, sign_mask);
+  x = _mm256_andnot_ps(sign_mask, x);
+
+  __m256i j = _mm256_cvttps_epi32(
+      _mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f)));
+  j = _mm256_add_epi32(j, _mm256_set1_epi32(1));
+  j = _mm256_and_si256(j, _mm256_set1_epi32(~1));
+  glm_vec8 const y = _mm256_cvtepi32_ps(j);
+
+  sign_sin = _mm256_xor_ps(sign_sin, _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_and_si256(j, _mm256_set1_epi32(4)), 29)));
+  glm_vec8 const sign_cos = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)),
+                          _mm256_set1_epi32(4)),
+      29));
+  glm_vec8 const poly_mask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+      _mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+
+  x = glm_vec8_fma(y, _mm256_set1_ps(-0.78515625f), x);
+  x = glm_vec8_fma(y, _mm256_set1_ps(-2.4187564849853515625e-4f), x);
+  x = glm_vec8_fma(y, _mm256_set1_ps(-3.77489497744594108e-8f), x);
+  glm_vec8 const z = _mm256_mul_ps(x, x);
+
+  glm_vec8 pc = _mm256_set1_ps(2.443315711809948e-5f);
+  pc = glm_vec8_fma(pc, z, _mm256_set1_ps(-1.388731625493765e-3f));
+  pc = glm_vec8_fma(pc, z, _mm256_set1_ps(4.166664568298827e-2f));
+  pc = _mm256_mul_ps(pc, _mm256_mul_ps(z, z));
+  pc = glm_vec8_fma(z, _mm256_set1_ps(-0.5f), pc);
+  pc = _mm256_add_ps(pc, _mm256_set1_ps(1.f));
+
+  glm_vec8 ps = _mm256_set1_ps(-1.9515295891e-4f);
+  ps = glm_vec8_fma(ps, z, _mm256_set1_ps(8.3321608736e-3f));
+  ps = glm_vec8_fma(ps, z, _mm256_set1_ps(-1.6666654611e-1f));
+  ps = glm_vec8_fma(_mm256_mul_ps(ps, z), x, x);
+
+  *s = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, poly_mask), sign_sin);
+  *c = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, poly_mask), sign_cos);
+}
+
+#endif  // GLM_ARCH & GLM_ARCH_AVX2_BIT
@@ -0,0 +1,464 @@
+#include "block_compress.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 一个 4x4 块, 按通道分开存 (SoA), 方便一次处理 4 个像素
+struct Block {
+  alignas(16) float channel[4][16];
+};
+
+// 从图里取出 (bx, by) 这一块, 超出图的部分重复边上的像素
+void LoadBlock(const unsigned char* rgba, int width, int height, int bx,
+               int by, Block* block) {
+  for (int y = 0; y < 4; y++) {
+    int sy = std::min(by * 4 + y, height - 1);
+    for (int x = 0; x < 4; x++) {
+      int sx = std::min(bx * 4 + x, width - 1);
+      const unsigned char* p =
+          rgba + (static_cast<size_t>(sy) * width + sx) * 4;
+      for (int c = 0; c < 4; c++) {
+        block->channel[c][y * 4 + x] = p[c];
+      }
+    }
+  }
+}
+
+// 16 个数的和
+inline float Sum16(const float* v) {
+#if defined(__SSE2__)
+  __m128 s = _mm_add_ps(_mm_add_ps(_mm_load_ps(v), _mm_load_ps(v + 4)),
+                        _mm_add_ps(_mm_load_ps(v + 8), _mm_load_ps(v + 12)));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+#else
+  float s = 0;
+  for (int i = 0; i < 16; i++) {
+    s += v[i];
+  }
+  return s;
+#endif
+}
+
+// 16 个 a[i] * b[i] 的和
+inline float Dot16(const float* a, const float* b) {
+#if defined(__SSE2__)
+  __m128 s = _mm_setzero_ps();
+  for (int i = 0; i < 16; i += 4) {
+    s = _mm_add_ps(s, _mm_mul_ps(_mm_load_ps(a + i), _mm_load_ps(b + i)));
+  }
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+#else
+  float s = 0;
+  for (int i = 0; i < 16; i++) {
+    s += a[i] * b[i];
+  }
+  return s;
+#endif
+}
+
+// 块在前 channels 个通道上的主成分方向 (协方差矩阵的最大特征向量)
+// 用幂迭代求, 4x4 以内几次就收敛了
+// 块是纯色时返回 false
+bool PrincipalAxis(const Block& block, int channels, float mean[4],
+                   float axis[4]) {
+  alignas(16) float centered[4][16];
+  for (int c = 0; c < channels; c++) {
+    mean[c] = Sum16(block.channel[c]) / 16.f;
+    for (int i = 0; i < 16; i++) {
+      centered[c][i] = block.channel[c][i] - mean[c];
+    }
+  }
+  float cov[4][4];
+  for (int i = 0; i < channels; i++) {
+    for (int j = i; j < channels; j++) {
+      cov[i][j] = cov[j][i] = Dot16(centered[i], centered[j]);
+    }
+  }
+
+  // 从对角线最大的那一维开始, 避免起点正好和主方向垂直
+  float v[4] = {0.f, 0.f, 0.f, 0.f};
+  int start = 0;
+  for (int c = 1; c < channels; c++) {
+    if (cov[c][c] > cov[start][start]) {
+      start = c;
+    }
+  }
+  if (cov[start][start] <= 0.f) {
+    return false;
+  }
+  v[start] = 1.f;
+  for (int iter = 0; iter < 8; iter++) {
+    float next[4] = {0.f, 0.f, 0.f, 0.f};
+    float norm = 0.f;
+    for (int i = 0; i < channels; i++) {
+      for (int j = 0; j < channels; j++) {
+        next[i] += cov[i][j] * v[j];
+      }
+      norm += next[i] * next[i];
+    }
+    if (norm <= 0.f) {
+      return false;
+    }
+    norm = 1.f / std::sqrt(norm);
+    for (int i = 0; i < channels; i++) {
+      v[i] = next[i] * norm;
+    }
+  }
+  for (int c = 0; c < 4; c++) {
+    axis[c] = c < channels ? v[c] : 0.f;
+  }
+  return true;
+}
+
+// 每个像素在 origin + t * axis 上的投影 t
+void Project(const Block& block, int channels, const float origin[4],
+             const float axis[4], float t[16]) {
+#if defined(__SSE2__)
+  for (int i = 0; i < 16; i += 4) {
+    __m128 s = _mm_setzero_ps();
+    for (int c = 0; c < channels; c++) {
+      __m128 d = _mm_sub_ps(_mm_load_ps(block.channel[c] + i),
+                            _mm_set1_ps(origin[c]));
+      s = _mm_add_ps(s, _mm_mul_ps(d, _mm_set1_ps(axis[c])));
+    }
+    _mm_storeu_ps(t + i, s);
+  }
+#else
+  for (int i = 0; i < 16; i++) {
+    float s = 0.f;
+    for (int c = 0; c < channels; c++) {
+      s += (block.channel[c][i] - origin[c]) * axis[c];
+    }
+    t[i] = s;
+  }
+#endif
+}
+
+// 在主成分方向上取两个端点: 投影的最小和最大处
+// 纯色块两个端点都是这个颜色
+void FitEndpoints(const Block& block, int channels, float lo[4],
+                  float hi[4]) {
+  float mean[4];
+  float axis[4];
+  if (!PrincipalAxis(block, channels, mean, axis)) {
+    for (int c = 0; c < 4; c++) {
+      lo[c] = hi[c] = block.channel[c][0];
+    }
+    return;
+  }
+  float t[16];
+  Project(block, channels, mean, axis, t);
+  float t_min = *std::min_element(t, t + 16);
+  float t_max = *std::max_element(t, t + 16);
+  for (int c = 0; c < 4; c++) {
+    float m = c < channels ? mean[c] : block.channel[c][0];
+    lo[c] = std::min(255.f, std::max(0.f, m + t_min * axis[c]));
+    hi[c] = std::min(255.f, std::max(0.f, m + t_max * axis[c]));
+  }
+}
+
+// 给每个像素在 palette 的 n 个颜色里挑最近的 (前 channels 个通道)
+void NearestColors(const Block& block, int channels, const float palette[][4],
+                   int n, uint8_t index[16]) {
+#if defined(__SSE2__)
+  for (int i = 0; i < 16; i += 4) {
+    __m128 best = _mm_set1_ps(1e30f);
+    __m128i best_index = _mm_setzero_si128();
+    for (int k = 0; k < n; k++) {
+      __m128 dist = _mm_setzero_ps();
+      for (int c = 0; c < channels; c++) {
+        __m128 d = _mm_sub_ps(_mm_load_ps(block.channel[c] + i),
+                              _mm_set1_ps(palette[k][c]));
+        dist = _mm_add_ps(dist, _mm_mul_ps(d, d));
+      }
+      __m128 closer = _mm_cmplt_ps(dist, best);
+      best = _mm_min_ps(dist, best);
+      __m128i mask = _mm_castps_si128(closer);
+      best_index = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi32(k)),
+                                _mm_andnot_si128(mask, best_index));
+    }
+    alignas(16) int32_t out[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(out), best_index);
+    for (int j = 0; j < 4; j++) {
+      index[i + j] = static_cast<uint8_t>(out[j]);
+    }
+  }
+#else
+  for (int i = 0; i < 16; i++) {
+    float best = 1e30f;
+    for (int k = 0; k < n; k++) {
+      float dist = 0.f;
+      for (int c = 0; c < channels; c++) {
+        float d = block.channel[c][i] - palette[k][c];
+        dist += d * d;
+      }
+      if (dist < best) {
+        best = dist;
+        index[i] = static_cast<uint8_t>(k);
+      }
+    }
+  }
+#endif
+}
+
+inline int Clamp(int v, int lo, int hi) {
+  return std::min(hi, std::max(lo, v));
+}
+
+inline uint16_t PackRgb565(const float c[4]) {
+  int r = Clamp(static_cast<int>(c[0] * 31.f / 255.f + 0.5f), 0, 31);
+  int g = Clamp(static_cast<int>(c[1] * 63.f / 255.f + 0.5f), 0, 63);
+  int b = Clamp(static_cast<int>(c[2] * 31.f / 255.f + 0.5f), 0, 31);
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+inline void UnpackRgb565(uint16_t v, float c[4]) {
+  int r = (v >> 11) & 31;
+  int g = (v >> 5) & 63;
+  int b = v & 31;
+  c[0] = static_cast<float>((r << 3) | (r >> 2));
+  c[1] = static_cast<float>((g << 2) | (g >> 4));
+  c[2] = static_cast<float>((b << 3) | (b >> 2));
+  c[3] = 255.f;
+}
+
+// BC1 的颜色部分, BC3 也用它
+// 总是 4 色模式 (c0 > c1), 端点相同时所有像素都取 c0
+void EncodeColorBlock(const Block& block, uint8_t out[8]) {
+  float lo[4];
+  float hi[4];
+  FitEndpoints(block, 3, lo, hi);
+  uint16_t c0 = PackRgb565(hi);
+  uint16_t c1 = PackRgb565(lo);
+  if (c0 < c1) {
+    std::swap(c0, c1);
+  }
+
+  uint32_t bits = 0;
+  if (c0 != c1) {
+    float palette[4][4];
+    UnpackRgb565(c0, palette[0]);
+    UnpackRgb565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+      palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+    }
+    uint8_t index[16];
+    NearestColors(block, 3, palette, 4, index);
+    for (int i = 15; i >= 0; i--) {
+      bits = (bits << 2) | index[i];
+    }
+  }
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+  for (int i = 0; i < 4; i++) {
+    out[4 + i] = (bits >> (8 * i)) & 0xff;
+  }
+}
+
+// BC3 的 alpha 部分
+// 8 值模式 (a0 > a1): 编码 0 为 a0, 1 为 a1, 2~7 为两者之间的 6 个值
+void EncodeAlphaBlock(const Block& block, uint8_t out[8]) {
+  const float* alpha = block.channel[3];
+  int a0 = static_cast<int>(*std::max_element(alpha, alpha + 16));
+  int a1 = static_cast<int>(*std::min_element(alpha, alpha + 16));
+  uint64_t bits = 0;
+  if (a0 != a1) {
+    for (int i = 15; i >= 0; i--) {
+      // 从 a0 到 a1 的第 step 个值 (0~7)
+      int step = Clamp(static_cast<int>((a0 - alpha[i]) * 7.f / (a0 - a1) +
+                                        0.5f),
+                       0, 7);
+      int code = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+      bits = (bits << 3) | code;
+    }
+  }
+  out[0] = static_cast<uint8_t>(a0);
+  out[1] = static_cast<uint8_t>(a1);
+  for (int i = 0; i < 6; i++) {
+    out[2 + i] = (bits >> (8 * i)) & 0xff;
+  }
+}
+
+// BC7 按位从低到高写
+class BitWriter {
+ public:
+  explicit BitWriter(uint8_t* out) : out_(out), pos_(0) { memset(out, 0, 16); }
+  void Write(uint32_t value, int bits) {
+    for (int i = 0; i < bits; i++, pos_++) {
+      if (value & (1u << i)) {
+        out_[pos_ >> 3] |= static_cast<uint8_t>(1u << (pos_ & 7));
+      }
+    }
+  }
+
+ private:
+  uint8_t* out_;
+  int pos_;
+};
+
+const int kBc7Weights4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                              34, 38, 43, 47, 51, 55, 60, 64};
+
+// 端点量化成 7 bit + 1 个共享的 p bit, 挑误差小的那个 p
+void QuantizeBc7Endpoint(const float c[4], int q[4], int* p) {
+  float best = 1e30f;
+  for (int pbit = 0; pbit < 2; pbit++) {
+    int candidate[4];
+    float err = 0.f;
+    for (int k = 0; k < 4; k++) {
+      candidate[k] =
+          Clamp(static_cast<int>((c[k] - pbit) / 2.f + 0.5f), 0, 127);
+      float d = c[k] - ((candidate[k] << 1) | pbit);
+      err += d * d;
+    }
+    if (err < best) {
+      best = err;
+      *p = pbit;
+      memcpy(q, candidate, sizeof(candidate));
+    }
+  }
+}
+
+// BC7 mode 6: 一个 subset, RGBA 端点各 7 bit + p bit, 每像素 4 bit 下标
+void EncodeBc7Block(const Block& block, uint8_t out[16]) {
+  float lo[4];
+  float hi[4];
+  FitEndpoints(block, 4, lo, hi);
+
+  int q[2][4];
+  int p[2];
+  QuantizeBc7Endpoint(lo, q[0], &p[0]);
+  QuantizeBc7Endpoint(hi, q[1], &p[1]);
+
+  float palette[16][4];
+  for (int k = 0; k < 16; k++) {
+    for (int c = 0; c < 4; c++) {
+      int e0 = (q[0][c] << 1) | p[0];
+      int e1 = (q[1][c] << 1) | p[1];
+      palette[k][c] = static_cast<float>(
+          ((64 - kBc7Weights4[k]) * e0 + kBc7Weights4[k] * e1 + 32) >> 6);
+    }
+  }
+  uint8_t index[16];
+  NearestColors(block, 4, palette, 16, index);
+
+  // 第一个像素的下标只存 3 bit, 最高位必须是 0, 不是的话把端点对调
+  if (index[0] & 8) {
+    for (int c = 0; c < 4; c++) {
+      std::swap(q[0][c], q[1][c]);
+    }
+    std::swap(p[0], p[1]);
+    for (int i = 0; i < 16; i++) {
+      index[i] = 15 - index[i];
+    }
+  }
+
+  BitWriter writer(out);
+  writer.Write(1 << 6, 7);  // mode 6
+  for (int c = 0; c < 4; c++) {
+    writer.Write(q[0][c], 7);
+    writer.Write(q[1][c], 7);
+  }
+  writer.Write(p[0], 1);
+  writer.Write(p[1], 1);
+  writer.Write(index[0], 3);
+  for (int i = 1; i < 16; i++) {
+    writer.Write(index[i], 4);
+  }
+}
+
+// 压缩第 [row_begin, row_end) 行块
+void CompressRows(BlockFormat format, const unsigned char* rgba, int width,
+                  int height, int row_begin, int row_end, uint8_t* out) {
+  int blocks_x = (width + 3) / 4;
+  size_t block_bytes = BlockBytes(format);
+  Block block;
+  for (int by = row_begin; by < row_end; by++) {
+    uint8_t* dst = out + static_cast<size_t>(by) * blocks_x * block_bytes;
+    for (int bx = 0; bx < blocks_x; bx++, dst += block_bytes) {
+      LoadBlock(rgba, width, height, bx, by, &block);
+      switch (format) {
+        case kBC1:
+          EncodeColorBlock(block, dst);
+          break;
+        case kBC3:
+          EncodeAlphaBlock(block, dst);
+          EncodeColorBlock(block, dst + 8);
+          break;
+        case kBC7:
+          EncodeBc7Block(block, dst);
+          break;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+size_t BlockBytes(BlockFormat format) { return format == kBC1 ? 8 : 16; }
+
+size_t CompressedSize(BlockFormat format, int width, int height) {
+  return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) *
+         BlockBytes(format);
+}
+
+const char* BlockFormatName(BlockFormat format) {
+  switch (format) {
+    case kBC1:
+      return "bc1";
+    case kBC3:
+      return "bc3";
+    case kBC7:
+      return "bc7";
+  }
+  return "unknown";
+}
+
+bool ParseBlockFormat(const std::string& name, BlockFormat* format) {
+  const BlockFormat formats[] = {kBC1, kBC3, kBC7};
+  for (BlockFormat f : formats) {
+    if (name == BlockFormatName(f)) {
+      *format = f;
+      return true;
+    }
+  }
+  return false;
+}
+
+void CompressImage(BlockFormat format, const unsigned char* rgba, int width,
+                   int height, int threads, std::vector<unsigned char>* out) {
+  out->resize(CompressedSize(format, width, height));
+  int blocks_y = (height + 3) / 4;
+  // 小图开线程不划算
+  int n = blocks_y < 16 ? 1 : std::min(std::max(1, threads), blocks_y);
+  if (n == 1) {
+    CompressRows(format, rgba, width, height, 0, blocks_y, out->data());
+    return;
+  }
+  std::vector<std::thread> workers;
+  for (int t = 0; t < n; t++) {
+    int begin = blocks_y * t / n;
+    int end = blocks_y * (t + 1) / n;
+    workers.push_back(std::thread(CompressRows, format, rgba, width, height,
+                                  begin, end, out->data()));
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
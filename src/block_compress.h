@@ -0,0 +1,32 @@
+#ifndef GL_EARTH_BLOCK_COMPRESS_H_
+#define GL_EARTH_BLOCK_COMPRESS_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// 块压缩格式, 都是把 4x4 个像素压成一个定长的块
+enum BlockFormat {
+  kBC1,  // S3TC DXT1, RGB, 8 字节一块, 4 bit/texel
+  kBC3,  // S3TC DXT5, RGBA, 16 字节一块, 8 bit/texel
+  kBC7,  // BPTC, RGBA, 16 字节一块, 8 bit/texel, 只用 mode 6
+};
+
+// 一块的字节数
+size_t BlockBytes(BlockFormat format);
+
+// width x height 的图压缩之后的字节数, 不足 4 的边按一整块算
+size_t CompressedSize(BlockFormat format, int width, int height);
+
+// 格式名 "bc1" / "bc3" / "bc7" 与枚举互转
+const char* BlockFormatName(BlockFormat format);
+bool ParseBlockFormat(const std::string& name, BlockFormat* format);
+
+// 把紧密排列的 RGBA8 图压成块, 块按行主序连续写进 out
+// 块的行按 threads 个线程切分并行压缩
+// 编码器是快速的单遍编码: 主成分方向上取端点, 再给每个像素挑最近的颜色,
+// 距离计算在有 SSE2 的地方一次算 4 个像素
+void CompressImage(BlockFormat format, const unsigned char* rgba, int width,
+                   int height, int threads, std::vector<unsigned char>* out);
+
+#endif  // GL_EARTH_BLOCK_COMPRESS_H_
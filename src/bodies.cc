@@ -0,0 +1,137 @@
+#include "bodies.h"
+
+#include <cstddef>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "shader.h"
+#include "sphere.h"
+
+namespace {
+
+// 天体在屏幕上只有几个像素, 很粗的球就够了
+const int kStacks = 4;
+const int kSlices = 8;
+
+// 实例属性接在 Mesh 的顶点属性后面
+const GLuint kOrbitAttribute = kFirstInstanceAttribute;
+const GLuint kTintAttribute = kFirstInstanceAttribute + 1;
+
+// 轨道在 xy 平面上, 以太阳 (原点) 为圆心
+// 朝着太阳的那一面亮
+// layout 的位置要和上面的一致
+const char kVertexShader[] =
+    GL_EARTH_GLSL_VERSION GL_EARTH_MATRIX_BLOCK
+    "uniform mat4 model;\n"
+    "uniform float time;\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 3) in vec4 orbit;\n"  // 半径, 相位, 角速度, 缩放
+    "layout(location = 4) in vec4 color;\n"
+    "out vec4 tint;\n"
+    "void main() {\n"
+    "  float angle = orbit.y + orbit.z * time;\n"
+    "  vec2 center = orbit.x * vec2(cos(angle), sin(angle));\n"
+    "  vec3 normal = position;\n"
+    "  float light = max(dot(normal.xy, -normalize(center)), 0.0);\n"
+    "  tint = vec4(color.rgb * (0.25 + 0.75 * light), color.a);\n"
+    "  gl_Position = projection * view * model *\n"
+    "                vec4(center + normal.xy * orbit.w, normal.z * orbit.w,\n"
+    "                     1.0);\n"
+    "}\n";
+
+const char kFragmentShader[] =
+    GL_EARTH_GLSL_VERSION
+    "in vec4 tint;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "  frag_color = tint;\n"
+    "}\n";
+
+}  // namespace
+
+bool BodyRegistry::Init() {
+  Release();
+  program_ = CompileProgram("bodies", kVertexShader, kFragmentShader);
+  if (!program_) {
+    return false;
+  }
+
+  std::vector<Vertex> vertices;
+  std::vector<GLuint> indices;
+  BuildUvSphere(kStacks, kSlices, &vertices, &indices);
+  mesh_.Upload(GL_TRIANGLES, vertices, indices);
+
+  // 实例属性挂在网格的 VAO 上, divisor 为 1 表示每个实例取一次
+  glGenBuffers(1, &instance_vbo_);
+  glBindVertexArray(mesh_.vao());
+  glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+  glEnableVertexAttribArray(kOrbitAttribute);
+  glVertexAttribPointer(
+      kOrbitAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Body),
+      reinterpret_cast<const GLvoid*>(offsetof(Body, orbit_radius)));
+  glVertexAttribDivisor(kOrbitAttribute, 1);
+  glEnableVertexAttribArray(kTintAttribute);
+  glVertexAttribPointer(kTintAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                        sizeof(Body),
+                        reinterpret_cast<const GLvoid*>(offsetof(Body, color)));
+  glVertexAttribDivisor(kTintAttribute, 1);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  dirty_ = true;
+  return true;
+}
+
+void BodyRegistry::Add(const Body& body) {
+  bodies_.push_back(body);
+  dirty_ = true;
+}
+
+void BodyRegistry::Clear() {
+  bodies_.clear();
+  dirty_ = true;
+}
+
+void BodyRegistry::Upload() {
+  glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+  glBufferData(GL_ARRAY_BUFFER, bodies_.size() * sizeof(Body), bodies_.data(),
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  uploaded_ = bodies_.size();
+  dirty_ = false;
+}
+
+void BodyRegistry::Draw(double time, const glm::mat4& model) {
+  if (!program_) {
+    return;
+  }
+  if (dirty_) {
+    Upload();
+  }
+  if (uploaded_ == 0) {
+    return;
+  }
+
+  glUseProgram(program_);
+  glUniform1f(glGetUniformLocation(program_, "time"), (GLfloat)time);
+  glUniformMatrix4fv(glGetUniformLocation(program_, "model"), 1, GL_FALSE,
+                     glm::value_ptr(model));
+  glEnable(GL_CULL_FACE);
+  glCullFace(GL_BACK);
+  mesh_.DrawInstanced(static_cast<GLsizei>(uploaded_));
+  glDisable(GL_CULL_FACE);
+  glUseProgram(0);
+}
+
+void BodyRegistry::Release() {
+  mesh_.Release();
+  if (instance_vbo_) {
+    glDeleteBuffers(1, &instance_vbo_);
+  }
+  if (program_) {
+    glDeleteProgram(program_);
+  }
+  instance_vbo_ = 0;
+  program_ = 0;
+  uploaded_ = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef GL_EARTH_BODIES_H_
+#define GL_EARTH_BODIES_H_
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+/**
+ * 一个绕太阳转的小天体 (卫星, 小行星...)
+ * 也是显存里每个实例的属性, 布局不能随便改
+ */
+struct Body {
+  GLfloat orbit_radius;
+  GLfloat phase;          // 初始相位 (弧度)
+  GLfloat angular_speed;  // 弧度每秒
+  GLfloat scale;          // 半径
+  GLubyte color[4];
+};
+
+/**
+ * 天体登记表
+ * 所有天体的属性放在一个实例 VBO 里, 位置在 vertex shader 里按时间算,
+ * 每帧一次 glDrawElementsInstanced 画完, 天体再多 draw call 也只有一个
+ * 属性没变就不用重新上传
+ */
+class BodyRegistry {
+ public:
+  BodyRegistry() : program_(0), instance_vbo_(0), uploaded_(0), dirty_(false) {}
+  ~BodyRegistry() { Release(); }
+
+  // 编译 shader, 建网格, 需要在 GL context 创建之后调用
+  // shader 编译失败时返回 false, 之后 Draw 什么也不画
+  bool Init();
+
+  // 增删改天体, 下一次 Draw 时统一上传
+  void Add(const Body& body);
+  void Clear();
+  Body& body(size_t i) {
+    dirty_ = true;
+    return bodies_[i];
+  }
+  size_t size() const { return bodies_.size(); }
+
+  // 画出所有天体, time 为模拟时间 (秒), model 为轨道平面的模型矩阵
+  void Draw(double time, const glm::mat4& model);
+
+  void Release();
+
+ private:
+  BodyRegistry(const BodyRegistry&) = delete;
+  BodyRegistry& operator=(const BodyRegistry&) = delete;
+
+  void Upload();
+
+  std::vector<Body> bodies_;
+  Mesh mesh_;
+  GLuint program_;
+  GLuint instance_vbo_;
+  size_t uploaded_;  // 显存里的实例数
+  bool dirty_;
+};
+
+#endif  // GL_EARTH_BODIES_H_
@@ -0,0 +1,226 @@
+#include "dds.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// 格式说明见
+// https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+const uint32_t kMagic = 0x20534444;  // "DDS "
+
+const uint32_t kFlagCaps = 0x1;
+const uint32_t kFlagHeight = 0x2;
+const uint32_t kFlagWidth = 0x4;
+const uint32_t kFlagPixelFormat = 0x1000;
+const uint32_t kFlagMipMapCount = 0x20000;
+const uint32_t kFlagLinearSize = 0x80000;
+
+const uint32_t kPixelFormatFourCC = 0x4;
+const uint32_t kPixelFormatRgb = 0x40;
+
+const uint32_t kCapsComplex = 0x8;
+const uint32_t kCapsTexture = 0x1000;
+const uint32_t kCapsMipMap = 0x400000;
+
+const uint32_t kDxgiRgba8 = 28;  // DXGI_FORMAT_R8G8B8A8_UNORM
+const uint32_t kDxgiBc1 = 71;
+const uint32_t kDxgiBc3 = 77;
+const uint32_t kDxgiBc7 = 98;
+const uint32_t kDimensionTexture2D = 3;
+
+// 文件头是外来的, 尺寸要先卡一下, 免得后面的乘法溢出
+const uint32_t kMaxSize = 1 << 16;
+const uint32_t kMaxLevels = 17;
+
+inline uint32_t FourCC(const char* s) {
+  return static_cast<uint32_t>(s[0]) | (static_cast<uint32_t>(s[1]) << 8) |
+         (static_cast<uint32_t>(s[2]) << 16) |
+         (static_cast<uint32_t>(s[3]) << 24);
+}
+
+struct PixelFormat {
+  uint32_t size;
+  uint32_t flags;
+  uint32_t four_cc;
+  uint32_t rgb_bit_count;
+  uint32_t r_mask;
+  uint32_t g_mask;
+  uint32_t b_mask;
+  uint32_t a_mask;
+};
+
+struct Header {
+  uint32_t size;
+  uint32_t flags;
+  uint32_t height;
+  uint32_t width;
+  uint32_t pitch_or_linear_size;
+  uint32_t depth;
+  uint32_t mip_map_count;
+  uint32_t reserved1[11];
+  PixelFormat pixel_format;
+  uint32_t caps;
+  uint32_t caps2;
+  uint32_t caps3;
+  uint32_t caps4;
+  uint32_t reserved2;
+};
+
+struct HeaderDx10 {
+  uint32_t dxgi_format;
+  uint32_t resource_dimension;
+  uint32_t misc_flag;
+  uint32_t array_size;
+  uint32_t misc_flags2;
+};
+
+static_assert(sizeof(Header) == 124, "DDS header must be 124 bytes");
+
+}  // namespace
+
+std::string DdsPathFor(const std::string& source) { return source + ".dds"; }
+
+bool WriteDds(const std::string& path, BlockFormat format,
+              const std::vector<MipLevel>& levels,
+              const std::vector<unsigned char>& data) {
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.size = sizeof(Header);
+  header.flags = kFlagCaps | kFlagHeight | kFlagWidth | kFlagPixelFormat |
+                 kFlagMipMapCount | kFlagLinearSize;
+  header.height = levels[0].height;
+  header.width = levels[0].width;
+  header.pitch_or_linear_size = static_cast<uint32_t>(levels[0].size);
+  header.mip_map_count = static_cast<uint32_t>(levels.size());
+  header.pixel_format.size = sizeof(PixelFormat);
+  header.pixel_format.flags = kPixelFormatFourCC;
+  header.caps = kCapsTexture;
+  if (levels.size() > 1) {
+    header.caps |= kCapsComplex | kCapsMipMap;
+  }
+
+  HeaderDx10 dx10;
+  memset(&dx10, 0, sizeof(dx10));
+  switch (format) {
+    case kBC1:
+      header.pixel_format.four_cc = FourCC("DXT1");
+      break;
+    case kBC3:
+      header.pixel_format.four_cc = FourCC("DXT5");
+      break;
+    case kBC7:
+      // BC7 只能用 DX10 扩展头描述
+      header.pixel_format.four_cc = FourCC("DX10");
+      dx10.dxgi_format = kDxgiBc7;
+      dx10.resource_dimension = kDimensionTexture2D;
+      dx10.array_size = 1;
+      break;
+  }
+
+  std::string tmp = path + ".tmp";
+  FILE* fp = fopen(tmp.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  bool ok = fwrite(&kMagic, sizeof(kMagic), 1, fp) == 1 &&
+            fwrite(&header, sizeof(header), 1, fp) == 1;
+  if (ok && format == kBC7) {
+    ok = fwrite(&dx10, sizeof(dx10), 1, fp) == 1;
+  }
+  ok = ok && fwrite(data.data(), 1, data.size(), fp) == data.size();
+  ok = fclose(fp) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ParseDds(const unsigned char* file, size_t size, bool* compressed,
+              BlockFormat* format, std::vector<MipLevel>* levels,
+              size_t* data_offset) {
+  uint32_t magic = 0;
+  Header header;
+  size_t offset = sizeof(magic) + sizeof(header);
+  if (size < offset) {
+    return false;
+  }
+  memcpy(&magic, file, sizeof(magic));
+  memcpy(&header, file + sizeof(magic), sizeof(header));
+  if (magic != kMagic || header.size != sizeof(Header) || header.width == 0 ||
+      header.height == 0 || header.width > kMaxSize ||
+      header.height > kMaxSize) {
+    return false;
+  }
+
+  const PixelFormat& pf = header.pixel_format;
+  *compressed = true;
+  if ((pf.flags & kPixelFormatRgb) && !(pf.flags & kPixelFormatFourCC)) {
+    // 未压缩的只认内存里是 R, G, B, A 顺序的 32 位格式
+    if (pf.rgb_bit_count != 32 || pf.r_mask != 0x000000ff ||
+        pf.g_mask != 0x0000ff00 || pf.b_mask != 0x00ff0000 ||
+        pf.a_mask != 0xff000000) {
+      return false;
+    }
+    *compressed = false;
+  } else if (!(pf.flags & kPixelFormatFourCC)) {
+    return false;
+  } else if (pf.four_cc == FourCC("DXT1")) {
+    *format = kBC1;
+  } else if (pf.four_cc == FourCC("DXT5")) {
+    *format = kBC3;
+  } else if (pf.four_cc == FourCC("DX10")) {
+    HeaderDx10 dx10;
+    if (size < offset + sizeof(dx10)) {
+      return false;
+    }
+    memcpy(&dx10, file + offset, sizeof(dx10));
+    offset += sizeof(dx10);
+    if (dx10.resource_dimension != kDimensionTexture2D ||
+        dx10.array_size > 1) {
+      return false;
+    }
+    if (dx10.dxgi_format == kDxgiBc1) {
+      *format = kBC1;
+    } else if (dx10.dxgi_format == kDxgiBc3) {
+      *format = kBC3;
+    } else if (dx10.dxgi_format == kDxgiBc7) {
+      *format = kBC7;
+    } else if (dx10.dxgi_format == kDxgiRgba8) {
+      *compressed = false;
+    } else {
+      return false;
+    }
+  } else {
+    return false;
+  }
+
+  // 没有 mipmap 的文件 mip_map_count 可能是 0
+  uint32_t count = (header.flags & kFlagMipMapCount)
+                       ? std::max<uint32_t>(header.mip_map_count, 1)
+                       : 1;
+  levels->clear();
+  size_t total = 0;
+  int w = static_cast<int>(header.width);
+  int h = static_cast<int>(header.height);
+  for (uint32_t i = 0; i < count && i < kMaxLevels; i++) {
+    size_t level_size = *compressed ? CompressedSize(*format, w, h)
+                                    : static_cast<size_t>(w) * h * 4;
+    MipLevel level = {w, h, total, level_size};
+    levels->push_back(level);
+    total += level.size;
+    w = std::max(1, w / 2);
+    h = std::max(1, h / 2);
+  }
+  if (total > size - offset) {
+    levels->clear();
+    return false;
+  }
+  *data_offset = offset;
+  return true;
+}
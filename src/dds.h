@@ -0,0 +1,29 @@
+#ifndef GL_EARTH_DDS_H_
+#define GL_EARTH_DDS_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "block_compress.h"
+#include "mipmap.h"
+
+// 源图对应的压缩贴图路径 (xxx.png.dds), 由 earth_texc 生成
+std::string DdsPathFor(const std::string& source);
+
+// 把块压缩的 mipmap 链写成 DDS
+// BC1/BC3 用 DXT1/DXT5 的 FourCC, BC7 需要 DX10 扩展头
+// 先写临时文件再 rename, 不会留下半个文件
+bool WriteDds(const std::string& path, BlockFormat format,
+              const std::vector<MipLevel>& levels,
+              const std::vector<unsigned char>& data);
+
+// 解析内存里 (一般是 mmap 进来的) 的 DDS, 不拷贝像素
+// 认 BC1/BC3/BC7 和未压缩的 RGBA8 2D 贴图, 别的返回 false
+// compressed 为 false 时是 RGBA8, format 无意义
+// levels 的 offset 相对于 *data_offset, 已经检查过都在 size 以内
+bool ParseDds(const unsigned char* file, size_t size, bool* compressed,
+              BlockFormat* format, std::vector<MipLevel>* levels,
+              size_t* data_offset);
+
+#endif  // GL_EARTH_DDS_H_
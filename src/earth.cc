@@ -1,17 +1,39 @@
 #include <unistd.h>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <functional>
+#include <random>
 #include <string>
+#include <vector>
 
-#include <SDL2/SDL_image.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/intersect.hpp>
+#include <glm/gtx/polar_coordinates.hpp>
 
-#ifdef __APPLE__
-#include <GLFW/glfw3.h>
-#else  // for linux : yum install glfw* :)
-#include <GL/glfw3.h>
-#endif
+#include "bodies.h"
+#include "frame_pacer.h"
+#include "frame_stats.h"
+#include "globe_quadtree.h"
+#include "headless.h"
+#include "idle_scheduler.h"
+#include "image.h"
+#include "input_queue.h"
+#include "mesh.h"
+#include "opengl.h"
+#include "point_layer.h"
+#include "scene_graph.h"
+#include "shader.h"
+#include "simulation.h"
+#include "sun.h"
+#include "texture_manager.h"
+#include "virtual_texture.h"
 
 /**
  * 打印键盘的 MOD,  aka SHIFT, CTRL, ALT, SUPER 的组合键解析
@@ -31,143 +53,236 @@ inline std::string KeyCallbackModParse(int mods) {
 class GLContext {
  public:
   // 初始化参数
-  GLContext() : speed_(1), earth_size_(0.3), offset_(0), texture_id_(0) {}
+  GLContext()
+      : earth_texture_(-1),
+        cursor_x_(0),
+        cursor_y_(0),
+        mesh_program_(0),
+        system_node_(0),
+        sun_node_(0),
+        earth_node_(0) {}
 
+  // 速度, 地球大小这些状态归模拟线程管, 这里只发命令过去
   // 加速
-  void SpeedUp() {
-    double rsec = glfwGetTime();
-    speed_++;
-    offset_ -= rsec * 50.f;
-    printf("[SpeedUp] current speed: %d offset: %.3f\n", speed_, offset_);
-    fflush(NULL);
-  }
+  void SpeedUp() { simulation_.Post(SimCommand::kSpeedUp); }
 
   // 减速
-  void SlowDown() {
-    double rsec = glfwGetTime();
-    speed_--;
-    offset_ += rsec * 50.f;
-    printf("[SlowDown] current speed: %d offset: %.3f\n", speed_, offset_);
-    fflush(NULL);
-  }
+  void SlowDown() { simulation_.Post(SimCommand::kSlowDown); }
 
-  void EarthSizeUp() {
-    earth_size_ += 0.01;
-    printf("[EarthSizeUp] current size: %.3f\n", earth_size_);
-    fflush(NULL);
-  }
+  void EarthSizeUp() { simulation_.Post(SimCommand::kEarthSizeUp); }
 
-  void EarthSizeDown() {
-    earth_size_ -= 0.01;
-    printf("[EarthSizeDown] current size: %.3f\n", earth_size_);
-    fflush(NULL);
-  }
+  void EarthSizeDown() { simulation_.Post(SimCommand::kEarthSizeDown); }
 
-  int& speed() { return speed_; }
-  double& offset() { return offset_; }
-  double& earth_size() { return earth_size_; }
-  GLuint& texture_id() { return texture_id_; }
+  Simulation& simulation() { return simulation_; }
+  TextureManager& textures() { return textures_; }
+  TextureManager::Handle& earth_texture() { return earth_texture_; }
+  VirtualTexture& virtual_texture() { return virtual_texture_; }
+  FrameStats& frame_stats() { return frame_stats_; }
+  FramePacer& pacer() { return pacer_; }
+  std::string& stats_path() { return stats_path_; }
+  InputQueue& input() { return input_; }
+  double& cursor_x() { return cursor_x_; }
+  double& cursor_y() { return cursor_y_; }
+  GlobeQuadtree& globe() { return globe_; }
+  Sun& sun() { return sun_; }
+  BodyRegistry& bodies() { return bodies_; }
+  std::deque<PointLayer>& point_layers() { return point_layers_; }
+  MatrixBlock& matrices() { return matrices_; }
+  glm::mat4& projection() { return projection_; }
+  glm::mat4& view() { return view_; }
+  GLuint& mesh_program() { return mesh_program_; }
+  SceneGraph& scene() { return scene_; }
+  SceneGraph::NodeId& system_node() { return system_node_; }
+  SceneGraph::NodeId& sun_node() { return sun_node_; }
+  SceneGraph::NodeId& earth_node() { return earth_node_; }
 
  private:
-  int speed_;
-  double earth_size_;
-  double offset_;
-  GLuint texture_id_;
+  Simulation simulation_;
+  // 普通贴图都归 TextureManager 管, 这里只留句柄
+  TextureManager textures_;
+  TextureManager::Handle earth_texture_;
+  VirtualTexture virtual_texture_;
+  FrameStats frame_stats_;
+  FramePacer pacer_;
+  std::string stats_path_;
+  InputQueue input_;
+  double cursor_x_;
+  double cursor_y_;
+  GlobeQuadtree globe_;
+  Sun sun_;
+  BodyRegistry bodies_;
+  std::deque<PointLayer> point_layers_;
+  MatrixBlock matrices_;
+  // 上一帧的矩阵, 鼠标点选时用来反投影
+  glm::mat4 projection_;
+  glm::mat4 view_;
+  GLuint mesh_program_;  // 画普通贴图的地球
+  SceneGraph scene_;
+  SceneGraph::NodeId system_node_;  // 太阳系, 小天体的轨道也在这一层
+  SceneGraph::NodeId sun_node_;
+  SceneGraph::NodeId earth_node_;
 };
 
+// 普通贴图的地球用的 fragment shader, 顶点的在 mesh.cc
+const char kMeshFragmentShader[] =
+    GL_EARTH_GLSL_VERSION
+    "uniform sampler2D image;\n"
+    "in vec2 uv;\n"
+    "in vec4 tint;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "  frag_color = texture(image, uv) * tint;\n"
+    "}\n";
+
+// 切到 mesh 程序, 设好这个物体的 model 矩阵
+void UseMeshProgram(const glm::mat4& model, GLContext* ctx) {
+  GLuint program = ctx->mesh_program();
+  glUseProgram(program);
+  glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE,
+                     glm::value_ptr(model));
+}
+
 // 画个太阳
-// 太阳其实是一组三角形构成
-// 组合类似于橘子
-// 当三角形足够多的时候
-// 就是一个圆形了
-void DrawSun(GLfloat radius, GLContext* ctx) {
-  int i;
-  int n_slice = 10000;  // $ of triangles used to draw circle
-  GLfloat PI_2 = 2.0f * M_PI;
-  static GLuint sun_list = 0;
-
-  // 因为太阳是固定的, 因此我们可以构造个 GenList, 然后将
-  // 其保存, 之后直接捞出来即可
-  if (!sun_list) {
-    sun_list = glGenLists(1);
-    glNewList(sun_list, GL_COMPILE_AND_EXECUTE);
-    glBegin(GL_TRIANGLE_FAN);
-    // 内顶点的颜色
-    // 颜色是 R, G, B, Alpha 四个值构成, 当然也可以用 RGB 3 值
-    // 不同于网上常见的 RGB 的 base 为 255 (aka FF), 此处的最大
-    // 值应该是 1.0, 当然超过了也不会报错, 只是没效果
-    glColor4f(.85f * 1.4, 0.69f * 1.4, 0.44f * 1.4, 1.f);
-    glVertex2f(0, 0);  // center of circle
-    for (i = 0; i <= n_slice; i++) {
-      glColor4f(.85f, 0.69f, 0.44f, 1.f);
-      // 圆边的某个顶点 x 和 y 坐标
-      // 内圆和外圆使用略微不同的颜色, opengl 会自动处理渐变效果
-      glVertex2f(radius * cos(i * PI_2 / n_slice),
-                 radius * sin(i * PI_2 / n_slice));
-    }
-    glEnd();
-    glEndList();
+// 以前太阳是一组三角形构成, 组合类似于橘子,
+// 当三角形足够多的时候就是一个圆形了
+// 现在是一个正方形, 圆是 fragment shader 算出来的 (见 sun.cc)
+void DrawSun(const glm::mat4& model, GLContext* ctx) {
+  // 缩放到目标半径的矩阵在场景图里 (见 InitSceneGraph)
+  ctx->sun().Draw(model);
+}
+
+// 画个地球
+// 以前是画一个正方形, 贴上事先准备好的图片
+// 现在是一个真正的球, 位置和大小在场景图里
+// 球按经纬度切成四叉树的块, 只画看得见的, 近处 (屏幕上大) 的块分得细,
+// 虚拟贴图也按同样的视锥和屏幕大小选 tile
+void DrawEarth(const glm::mat4& model, const glm::mat4& view,
+               const glm::mat4& projection, int width, int height,
+               GLContext* ctx) {
+  GlobeQuadtree& globe = ctx->globe();
+  globe.Update(model, view, projection, width, height);
+
+  // 超大的图走虚拟贴图, 否则就是一张普通贴图
+  VirtualTexture& vt = ctx->virtual_texture();
+  if (vt.failed()) {
+    // tile 金字塔打不开, 退回普通贴图, 至少还能看到地图
+    fprintf(stderr, "[VT] fall back to a regular texture for %s\n",
+            vt.path().c_str());
+    ctx->earth_texture() = ctx->textures().Add(vt.path());
+    vt.Release();
+  }
+  if (vt.loaded()) {
+    vt.Update(model, view, projection, width, height);
+    vt.Bind(model);
   } else {
-    // 捞出那个圆
-    glCallList(sun_list);
+    UseMeshProgram(model, ctx);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D,
+                  ctx->textures().Use(ctx->earth_texture()));
+  }
+  // 球是凸的, 剔除背面就不需要深度测试了 (裙边见 GlobeQuadtree)
+  globe.Draw();
+  if (vt.loaded()) {
+    vt.Unbind();
+  } else {
+    glUseProgram(0);
   }
 }
 
-// 画个地球
-// 此处做法很粗暴, 画一个正方形
-// 贴上事先准备好的图片
-// 然后就算完事
-void DrawEarth(GLfloat x, GLfloat y, GLfloat radius, GLContext* ctx) {
-  glEnable(GL_TEXTURE_2D);
-  glBindTexture(GL_TEXTURE_2D, ctx->texture_id());
-  glBegin(GL_QUADS);
-  glColor3f(1.f, 1.f, 1.f);
-  glTexCoord2f(0.0, 0.0);
-  glVertex3f(x + 0.0 * radius, y + 0.0 * radius, 0.0);
-  glTexCoord2f(1, 0.0);
-  glVertex3f(x + 1.0 * radius, y + 0.0 * radius, 0.0);
-  glTexCoord2f(1.0, 1.0);
-  glVertex3f(x + 1.0 * radius, y + 1.0 * radius, 0.0);
-  glTexCoord2f(0.0, 1.0);
-  glVertex3f(x + 0.0, y + 1.0 * radius, 0.0);
-  glEnd();
-  glDisable(GL_TEXTURE_2D);
+// 画点图层, 每层每个 GPU buffer 一次 draw call
+void DrawPoints(const glm::mat4& model, const glm::mat4& view,
+                const glm::mat4& projection, GLContext* ctx) {
+  for (PointLayer& layer : ctx->point_layers()) {
+    layer.Draw(model, view, projection);
+  }
+}
+
+// 构造网格
+// 以前每帧都用 glBegin/glEnd 一个点一个点地送给驱动,
+// 太阳则依赖 display list, 软件渲染 (Mesa) 下非常慢
+// 现在启动时一次性构造好 VBO/VAO, 之后每个物体一次 glDrawElements
+// corona 为日冕的亮度, 0 为不要
+void InitMeshes(float corona, GLContext* ctx) {
+  ctx->mesh_program() =
+      CompileProgram("mesh", kMeshVertexShader, kMeshFragmentShader);
+  GLuint program = ctx->mesh_program();
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "image"), 0);
+  glUseProgram(0);
+
+  ctx->globe().Build();
+
+  // 圆心的颜色
+  // 颜色是 R, G, B, Alpha 四个值构成, 当然也可以用 RGB 3 值
+  // 不同于网上常见的 RGB 的 base 为 255 (aka FF), 此处的最大
+  // 值应该是 1.0, 当然超过了也不会报错, 只是没效果
+  GLfloat center_color[4] = {.85f * 1.4f, 0.69f * 1.4f, 0.44f * 1.4f, 1.f};
+  GLfloat edge_color[4] = {.85f, 0.69f, 0.44f, 1.f};
+  ctx->sun().Init(center_color, edge_color, corona);
 }
 
-// 载入贴图
-// 虽然引用太多第三方包不太好
-// 但是 glfw3 直接把自带的载入图给干掉了
-// 说他们要专注
-// 真是没办法
-// 因此我使用 SDL2 的库
-// https://www.libsdl.org/
-// Simple DirectMedia Layer is a cross-platform
-// development library designed to provide low level access
-// to audio, keyboard, mouse, joystick, and graphics hardware
-// via OpenGL and Direct3D. It is used by video playback
-// software, emulators, and popular games including Valve's
-// award winning catalog and many Humble Bundle games.
-// 使用前, 全局至少加载一次
-int LoadTexture(const std::string& path) {
-  GLuint texture_id;
-  glGenTextures(1, &texture_id);
-  glBindTexture(GL_TEXTURE_2D, texture_id);
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-  SDL_Surface* img = IMG_Load(path.c_str());
-  printf("%s:%d -- %d %d %p\n", __FILE__, __LINE__, img->w, img->h,
-         img->pixels);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img->w, img->h, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, img->pixels);
-
-  // gluBuild2DMipmaps(GL_TEXTURE_2D, GL_RGBA, img->w, img->h, GL_RGBA,
-  // GL_UNSIGNED_BYTE, img->pixels);
-  SDL_FreeSurface(img);
-  return texture_id;
+// 搭场景图
+// 太阳永远在正中心, 地球的位置跟着它的大小变 (见 UpdateSceneGraph)
+void InitSceneGraph(GLContext* ctx) {
+  SceneGraph& scene = ctx->scene();
+  ctx->system_node() = scene.AddNode(SceneGraph::kNoParent);
+  ctx->sun_node() = scene.AddNode(ctx->system_node(), glm::vec3(0.f),
+                                  glm::quat(), glm::vec3(0.2f, 0.2f, 1.f));
+  ctx->earth_node() = scene.AddNode(ctx->system_node());
+}
+
+// 把模拟状态写进场景图, 只有变了的节点才会被重算
+void UpdateSceneGraph(const SimState& state, GLContext* ctx) {
+  SceneGraph& scene = ctx->scene();
+  // 实际上, 我做了个 tricky 的操作
+  // 太阳永远是在 0,0 即正中心,
+  // 而地球占据 (x, 0) 开始边长为 earth_size 的正方形区域
+  // 我旋转的其实是我们的观察视角 :)
+  GLfloat r = (GLfloat)state.earth_size / 2.f;
+  scene.SetTranslation(ctx->earth_node(), glm::vec3(0.6f + r, r, 0.f));
+  scene.SetScale(ctx->earth_node(), glm::vec3(r));
+  scene.Update();
+}
+
+// 载入点图层, 每层一个颜色, 轮着用
+void InitPointLayers(const std::vector<std::string>& paths, GLContext* ctx) {
+  static const glm::vec4 kColors[] = {
+      glm::vec4(1.f, .55f, .1f, 1.f), glm::vec4(.2f, .9f, 1.f, 1.f),
+      glm::vec4(1.f, .3f, .8f, 1.f), glm::vec4(.5f, 1.f, .3f, 1.f),
+  };
+  const size_t color_count = sizeof(kColors) / sizeof(kColors[0]);
+  for (size_t i = 0; i < paths.size(); i++) {
+    ctx->point_layers().emplace_back();
+    ctx->point_layers().back().Load(paths[i], kColors[i % color_count]);
+  }
+}
+
+// 生成 count 个绕太阳转的小天体
+// 固定的随机种子, 每次生成的星座都一样, 基准测试可以互相比较
+void InitBodies(int count, GLContext* ctx) {
+  BodyRegistry& bodies = ctx->bodies();
+  if (count <= 0 || !bodies.Init()) {
+    return;
+  }
+  std::mt19937 rng(20170101);
+  std::uniform_real_distribution<float> radius(0.25f, 0.95f);
+  std::uniform_real_distribution<float> phase(0.f, 2.f * M_PI);
+  std::uniform_real_distribution<float> scale(0.003f, 0.01f);
+  std::uniform_int_distribution<int> shade(160, 255);
+  for (int i = 0; i < count; i++) {
+    Body body;
+    body.orbit_radius = radius(rng);
+    body.phase = phase(rng);
+    // 开普勒第三定律, 越远转得越慢, 顺便让一半逆行
+    body.angular_speed =
+        0.3f / std::pow(body.orbit_radius, 1.5f) * (i % 2 ? 1.f : -1.f);
+    body.scale = scale(rng);
+    body.color[0] = (GLubyte)shade(rng);
+    body.color[1] = (GLubyte)shade(rng);
+    body.color[2] = 255;
+    body.color[3] = 255;
+    bodies.Add(body);
+  }
 }
 
 // 打印说明
@@ -177,33 +292,583 @@ void PrintHelper() {
   int major, minor, revision;
   glfwGetVersion(&major, &minor, &revision);
   printf("Running against GLFW %i.%i.%i\n", major, minor, revision);
+  printf("Usage: earth [options] [image]\n");
+  printf("  --virtual-texture: stream the image as tiles, for 16k+ imagery\n");
+  printf("  --stats file: export frame timings on exit, .json or .csv\n");
+  printf("  --headless: render offscreen through EGL, no window\n");
+  printf("  --size WxH: offscreen resolution, default 640x480\n");
+  printf("  --frames N: frames to render in headless/bench mode, "
+         "default 600\n");
+  printf("  --dump file.ppm: save the last headless frame\n");
+  printf("  --bench: fixed timestep benchmark, no vsync, report and exit\n");
+  printf("  --dt X: simulated seconds per benchmark frame, default 1/60\n");
+  printf("  --bodies N: N satellites orbiting the sun, default 0\n");
+  printf("  --points file: lat/lon point layer (EPTS), may be repeated\n");
+  printf("  --corona X: brightness of the glow around the sun, default 0\n");
+  printf("  --pacing MODE: vsync, adaptive, sleep or off, default vsync\n");
+  printf("  --fps N: frame rate cap, default none (60 for --pacing sleep)\n");
+  printf("  --texture-budget MB: GPU memory for textures, LRU evicted, "
+         "default %d\n",
+         static_cast<int>(TextureManager::kDefaultBudget >> 20));
   printf("Operations: \n");
   printf("+/- : speed up/down\n");
   printf("v : print window size in terminal\n");
+  printf("left click: print lat/lon and the nearest point under the cursor\n");
   printf("arrow up/down: change the size of earth\n");
+  printf("p: print frame timings and export them\n");
   printf("h: hide this window\n");
   printf("s: show this window\n");
   printf("q, ESC: Quit this program\n");
 }
 
+/**
+ * 命令行参数
+ */
+struct Options {
+  Options()
+      : image("../resource/earth-modified.png"),
+        use_virtual_texture(false),
+        headless(false),
+        width(640),
+        height(480),
+        frames(600),
+        bench(false),
+        dt(1.0 / 60),
+        bodies(0),
+        corona(0),
+        pacing(kPacingVsync),
+        fps(0),
+        texture_budget(TextureManager::kDefaultBudget) {}
+
+  std::string image;
+  bool use_virtual_texture;
+  std::string stats;
+  // 无窗口模式, 画到离屏的 framebuffer 上
+  bool headless;
+  int width;
+  int height;
+  int frames;
+  std::string dump;
+  // 基准测试: 模拟时钟, 每帧前进 dt 秒, 关掉 vsync, 画 frames 帧
+  bool bench;
+  double dt;
+  // 绕太阳转的小天体个数
+  int bodies;
+  // 点图层的文件
+  std::vector<std::string> points;
+  // 太阳外面日冕的亮度
+  float corona;
+  // 帧节奏和帧率上限, 0 为不限
+  PacingMode pacing;
+  double fps;
+  // 普通贴图的显存预算 (字节)
+  size_t texture_budget;
+};
+
+// 解析命令行, 不认识的参数返回 false
+bool ParseOptions(int argc, char* argv[], Options* options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--virtual-texture") {
+      options->use_virtual_texture = true;
+    } else if (arg == "--stats" && has_value) {
+      options->stats = argv[++i];
+    } else if (arg == "--headless") {
+      options->headless = true;
+    } else if (arg == "--size" && has_value) {
+      if (sscanf(argv[++i], "%dx%d", &options->width, &options->height) != 2 ||
+          options->width <= 0 || options->height <= 0) {
+        return false;
+      }
+    } else if (arg == "--frames" && has_value) {
+      options->frames = atoi(argv[++i]);
+    } else if (arg == "--dump" && has_value) {
+      options->dump = argv[++i];
+    } else if (arg == "--bench") {
+      options->bench = true;
+    } else if (arg == "--dt" && has_value) {
+      options->dt = atof(argv[++i]);
+    } else if (arg == "--bodies" && has_value) {
+      options->bodies = atoi(argv[++i]);
+    } else if (arg == "--points" && has_value) {
+      options->points.push_back(argv[++i]);
+    } else if (arg == "--corona" && has_value) {
+      options->corona = atof(argv[++i]);
+    } else if (arg == "--pacing" && has_value) {
+      if (!ParsePacingMode(argv[++i], &options->pacing)) {
+        return false;
+      }
+    } else if (arg == "--fps" && has_value) {
+      options->fps = atof(argv[++i]);
+    } else if (arg == "--texture-budget" && has_value) {
+      // 负数, NaN 和大得离谱的值转成 size_t 是未定义行为, 直接当错误
+      double mb = atof(argv[++i]);
+      if (!(mb > 0) || mb > 1048576) {
+        return false;
+      }
+      options->texture_budget = static_cast<size_t>(mb * 1048576);
+    } else if (arg.compare(0, 2, "--") == 0) {
+      return false;
+    } else {
+      options->image = arg;
+    }
+  }
+  return true;
+}
+
+// 初始化场景: 贴图, 网格, 统计
+// 需要在 GL context 创建之后调用, 窗口和 headless 共用
+void InitScene(const Options& options, GLContext* ctx) {
+  // 载入材质
+  // 全局只需要载入 1 次
+  // 解码在后台线程进行, 图没好之前先画占位贴图, 第一帧不用等
+  // 虚拟贴图则是按需一块一块地载入
+  // 虚拟贴图失败时会退回普通贴图, 所以预算总是要设
+  ctx->textures().set_budget(options.texture_budget);
+  if (options.use_virtual_texture) {
+    ctx->virtual_texture().Load(options.image);
+  } else {
+    ctx->earth_texture() = ctx->textures().Add(options.image);
+  }
+
+  // 所有 shader 共用的矩阵
+  ctx->matrices().Init();
+
+  // 网格也只需要构造 1 次
+  InitMeshes(options.corona, ctx);
+  InitSceneGraph(ctx);
+  InitBodies(options.bodies, ctx);
+  InitPointLayers(options.points, ctx);
+
+  // 帧耗时统计
+  // 以前每 3 秒按整数秒算一次平均 FPS, 卡顿完全看不出来
+  // 现在每一帧都用高精度时钟记下来, 放进直方图
+  ctx->frame_stats().Init();
+}
+
+// 画一帧, 窗口和 headless 共用
+// state 为这一帧要画的模拟状态, 已经插值好了
+void RenderFrame(int width, int height, const SimState& state,
+                 GLContext* ctx) {
+  // 后台解码好的贴图在这里上传, 超出显存预算的在这里淘汰
+  ctx->textures().Update();
+  for (PointLayer& layer : ctx->point_layers()) {
+    layer.Poll();
+  }
+
+  // 变了的节点才重算世界矩阵, 太阳这种不动的只算一次
+  UpdateSceneGraph(state, ctx);
+  SceneGraph& scene = ctx->scene();
+
+  // 构造界面开始
+  float ratio = width / (float)height;
+  glViewport(0, 0, width, height);
+
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  // 矩阵在 CPU 上用 glm 算好, 每帧通过 uniform buffer 上传一次,
+  // 所有 shader 共用; core profile 没有 glMatrixMode/glOrtho/glRotatef 了
+  // 地球的模型空间 z 在 ±earth_size / 2 之间, 放大到超过 2 以后
+  // 深度 ±1 会把前后两半裁掉, 视锥剔除也用这两个面, 所以跟着地球一起放大
+  float depth = std::max(1.f, (float)state.earth_size);
+  glm::mat4 projection = glm::ortho(-ratio, ratio, -1.f, 1.f, depth, -depth);
+  // 此处, 我们旋转自己的 view
+  glm::mat4 view = glm::rotate(
+      glm::mat4(1.f), glm::radians((float)fmod(state.angle, 360.0)),
+      glm::vec3(0.f, 0.f, 1.f));
+  ctx->matrices().Upload(projection, view);
+  ctx->projection() = projection;
+  ctx->view() = view;
+
+  // 关于世界观, 我找了下, 这个文档可能是一个不错的说明:
+  // https://learnopengl-cn.github.io/01%20Getting%20started/08%20Coordinate%20Systems/
+
+  // 构造界面结束
+
+  // 画地球
+  DrawEarth(scene.world(ctx->earth_node()), view, projection, width, height,
+            ctx);
+
+  // 地球上的点, 只画朝着我们而且在屏幕里的块
+  DrawPoints(scene.world(ctx->earth_node()), view, projection, ctx);
+
+  // 画小天体, 不管多少个都只有一次 draw call
+  ctx->bodies().Draw(state.time, scene.world(ctx->system_node()));
+
+  // 画太阳
+  DrawSun(scene.world(ctx->sun_node()), ctx);
+}
+
+// 打印统计, 释放显存
+// 需要在 context 还有效的时候调用
+void ReleaseScene(GLContext* ctx) {
+  FrameStats& stats = ctx->frame_stats();
+  stats.Print(stdout);
+  if (ctx->pacer().frames()) {
+    ctx->pacer().Print(stdout);
+  }
+  if (!ctx->stats_path().empty()) {
+    stats.Export(ctx->stats_path());
+  }
+
+  ctx->globe().Release();
+  ctx->sun().Release();
+  ctx->bodies().Release();
+  for (PointLayer& layer : ctx->point_layers()) {
+    layer.Release();
+  }
+  ctx->matrices().Release();
+  if (ctx->mesh_program()) {
+    glDeleteProgram(ctx->mesh_program());
+    ctx->mesh_program() = 0;
+  }
+  ctx->textures().Release();
+  ctx->virtual_texture().Release();
+  stats.Release();
+}
+
+// 模拟线程的 tick 间隔 (秒), 与渲染帧率无关
+const double kSimulationTick = 1.0 / 120;
+
+// 一帧的 swap, 窗口模式是 glfwSwapBuffers, headless 是 glFinish
+typedef std::function<void()> PresentFunc;
+
+// 异步载入的贴图是否都到位了
+bool SceneSettled(GLContext* ctx) {
+  for (const PointLayer& layer : ctx->point_layers()) {
+    if (!layer.settled()) {
+      return false;
+    }
+  }
+  return ctx->textures().settled() && ctx->virtual_texture().settled();
+}
+
+// 基准测试
+// 先预热到贴图都载入完毕, 然后每帧同步地推进一个 dt 的 tick,
+// 不起模拟线程, 与墙上时钟无关, 所以每次跑的画面完全一样, 结果可以互相比较
+// 画完 frames 帧之后打印吞吐量和帧耗时分布
+void RunBench(const Options& options, int width, int height,
+              const PresentFunc& present, GLContext* ctx) {
+  typedef std::chrono::steady_clock Clock;
+  Simulation& simulation = ctx->simulation();
+  Clock::time_point start = Clock::now();
+  while (!SceneSettled(ctx)) {
+    RenderFrame(width, height, simulation.Latest(), ctx);
+    present();
+    if (Clock::now() - start > std::chrono::seconds(30)) {
+      fprintf(stderr, "[Bench] textures not settled after 30s, go on\n");
+      break;
+    }
+  }
+
+  FrameStats& stats = ctx->frame_stats();
+  start = Clock::now();
+  for (int i = 0; i < options.frames; i++) {
+    stats.BeginFrame();
+    if (i > 0) {
+      simulation.Step(options.dt);
+    }
+    RenderFrame(width, height, simulation.Latest(), ctx);
+    stats.BeginSwap();
+    present();
+    stats.EndFrame();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("[Bench] %dx%d %d frames, dt %.4f: %.3f s, %.1f fps\n", width, height,
+         options.frames, options.dt, seconds,
+         seconds > 0 ? options.frames / seconds : 0.0);
+}
+
+// 无窗口模式
+// 不初始化 glfw, 用 EGL 建一个离屏的 context, 画 frames 帧之后退出
+// 画的代码和窗口模式完全一样, 分辨率随意
+int RunHeadless(const Options& options, GLContext* ctx) {
+  if (!InitImageDecoder()) {
+    return -1;
+  }
+
+  HeadlessContext headless;
+  if (!headless.Create(options.width, options.height)) {
+    return -1;
+  }
+  InitScene(options, ctx);
+
+  if (options.bench) {
+    RunBench(options, options.width, options.height,
+             [&headless] { headless.Present(); }, ctx);
+  } else {
+    FrameStats& stats = ctx->frame_stats();
+    Simulation& simulation = ctx->simulation();
+    // 没有 swap 可等, vsync/adaptive 在这里等于 off, 只有 --fps 起作用
+    PacingMode mode = options.pacing == kPacingSleep ? kPacingSleep
+                                                     : kPacingOff;
+    FramePacer& pacer = ctx->pacer();
+    pacer.Init(mode, options.fps, 0);
+    simulation.Start(kSimulationTick);
+    for (int i = 0; i < options.frames; i++) {
+      pacer.Wait();
+      stats.BeginFrame();
+      RenderFrame(options.width, options.height,
+                  simulation.Sample(simulation.Now()), ctx);
+      stats.BeginSwap();
+      headless.Present();
+      stats.EndFrame();
+    }
+    simulation.Stop();
+  }
+
+  if (!options.dump.empty()) {
+    headless.SavePpm(options.dump);
+  }
+  ReleaseScene(ctx);
+  headless.Destroy();
+  printf("Bye!\n");
+  return 0;
+}
+
+// 按 --pacing/--fps 设置帧节奏和 swap interval, 需要 context current
+// http://www.glfw.org/docs/latest/group__context.html#ga6d4e0cdf151b5e579bd67f13202994ed
+void InitPacing(const Options& options, GLContext* ctx) {
+  // 基准测试时关掉 vsync, 能跑多快跑多快
+  PacingMode mode = options.bench ? kPacingOff : options.pacing;
+  const GLFWvidmode* video = glfwGetVideoMode(glfwGetPrimaryMonitor());
+  FramePacer& pacer = ctx->pacer();
+  pacer.Init(mode, options.fps, video ? video->refreshRate : 0);
+  // swap interval -1 (赶不上就撕裂, 不等下一个 vsync) 要 swap_control_tear
+  if (mode == kPacingAdaptive &&
+      !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+      !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+    fprintf(stderr, "swap control tear not supported, pacing falls back to "
+                    "vsync\n");
+    pacer.FallBackToVsync();
+  }
+  glfwSwapInterval(pacer.swap_interval());
+  printf("[FramePacer] %s, swap interval %d\n", PacingModeName(pacer.mode()),
+         pacer.swap_interval());
+}
+
+// 键盘事件
+void HandleKey(GLFWwindow* window, int key, int action, int mods,
+               GLContext* ctx) {
+  // double rsec = ctx->simulation().Now();
+  // printf("[KEY]: %c %d %s %s --- %.3f\n", key, key,
+  //        action == GLFW_PRESS
+  //            ? "GLFW_PRESS"
+  //            : (action == GLFW_RELEASE ? "GLFW_RELEASE" : "GLFW_REPEAT"),
+  //        KeyCallbackModParse(mods).c_str(), rsec);
+  // fflush(NULL);
+
+  // action: GLFW_PRESS 表示按下, GLFW_REPEAT 表示按着不放, 一段时间后
+  // 再次触发
+  if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+    switch (key) {
+      case '+':
+      case '=':
+        ctx->SpeedUp();
+        break;
+      case '-':
+      case '_':
+        ctx->SlowDown();
+        break;
+      case 'v':
+      case 'V':
+        int w;
+        int h;
+        glfwGetFramebufferSize(window, &w, &h);
+        printf("glfwGetFramebufferSize: %d %d\n", w, h);
+        printf("globe: %zu patches, %zu triangles\n",
+               ctx->globe().patch_count(), ctx->globe().triangle_count());
+        break;
+      case GLFW_KEY_UP:
+        ctx->EarthSizeUp();
+        break;
+      case GLFW_KEY_DOWN:
+        ctx->EarthSizeDown();
+        break;
+      case 'p':
+      case 'P':
+        ctx->frame_stats().Print(stdout);
+        ctx->frame_stats().Export(ctx->stats_path().empty()
+                                      ? "frame_stats.json"
+                                      : ctx->stats_path());
+        break;
+      case 'h':
+      case 'H':
+        glfwHideWindow(window);
+        break;
+      case 's':
+      case 'S':
+        glfwShowWindow(window);
+        break;
+      case GLFW_KEY_ESCAPE:
+      case 'q':
+      case 'Q':
+        // http://www.glfw.org/docs/latest/group__window.html#ga49c449dde2a6f87d996f4daaa09d6708
+        glfwSetWindowShouldClose(window, GL_TRUE);
+        break;
+      default:
+        // nothing
+        break;
+    }
+  }
+}
+
+// 点选时光标周围多少像素内的点都算点中
+const float kPickPixels = 8.f;
+const float kEarthRadiusKm = 6371.f;
+
+// 鼠标点在地球上哪里, 附近最近的点是哪个
+// 光标反投影成一条射线, 和单位球求交得到经纬度;
+// 点的查找在 PointLayer::Pick 里, 先按块的包围球筛, 再在块里的 k-d 树上找
+void PickAt(GLFWwindow* window, GLContext* ctx) {
+  int width, height;
+  glfwGetWindowSize(window, &width, &height);
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  // 光标是窗口坐标, y 朝下; 这里只用比例, 不管 framebuffer 的缩放
+  float x = 2.f * (float)ctx->cursor_x() / width - 1.f;
+  float y = 1.f - 2.f * (float)ctx->cursor_y() / height;
+  // 反投影到地球的模型空间, 那里地球就是单位球
+  glm::mat4 model = ctx->scene().world(ctx->earth_node());
+  glm::mat4 inverse = glm::inverse(ctx->projection() * ctx->view() * model);
+  auto unproject = [&inverse](float x, float y, float z) {
+    glm::vec4 p = inverse * glm::vec4(x, y, z, 1.f);
+    return glm::vec3(p) / p.w;
+  };
+  // 正交投影 z = 1 离我们最近
+  glm::vec3 front = unproject(x, y, 1.f);
+  glm::vec3 back = unproject(x, y, -1.f);
+  glm::vec3 dir = glm::normalize(back - front);
+  // 近平面可能切进地球里, 起点先挪到球外面
+  glm::vec3 origin = front - dir * (glm::length(front) + 1.f);
+  float distance;
+  if (!glm::intersectRaySphere(origin, dir, glm::vec3(0.f), 1.f, distance)) {
+    printf("[PICK] miss\n");
+    return;
+  }
+  glm::vec3 hit = origin + dir * distance;
+  glm::vec3 polar = glm::polar(hit);
+  printf("[PICK] lat %.4f lon %.4f\n", glm::degrees(polar.x),
+         glm::degrees(polar.y));
+
+  // 容差是光标旁边 kPickPixels 像素反投影回来的长度
+  float tolerance =
+      glm::length(unproject(x + 2.f * kPickPixels / width, y, 1.f) - front);
+  auto start = std::chrono::steady_clock::now();
+  PointPick best;
+  best.distance = tolerance;
+  bool found = false;
+  for (const PointLayer& layer : ctx->point_layers()) {
+    PointPick pick;
+    if (layer.Pick(hit, best.distance, &pick) &&
+        pick.distance <= best.distance) {
+      best = pick;
+      found = true;
+    }
+  }
+  long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  if (!found) {
+    printf("[PICK] no point within %.1f km, %lld us\n",
+           tolerance * kEarthRadiusKm, us);
+  } else if (std::isnan(best.value)) {
+    printf("[PICK] point lat %.4f lon %.4f, %.1f km away, %lld us\n",
+           best.lat, best.lon, best.distance * kEarthRadiusKm, us);
+  } else {
+    printf("[PICK] point lat %.4f lon %.4f value %g, %.1f km away, %lld us\n",
+           best.lat, best.lon, best.value, best.distance * kEarthRadiusKm,
+           us);
+  }
+}
+
+// 处理输入队列里攒下的事件
+// 每帧在主循环的固定位置调用一次, 一次处理完
+// 返回 true 表示有事件可能改变画面, 需要重画
+bool DrainInput(GLFWwindow* window, GLContext* ctx) {
+  InputEvent event;
+  bool any = false;
+  bool redraw = false;
+  while (ctx->input().Pop(&event)) {
+    any = true;
+    switch (event.type) {
+      case InputEvent::kKey:
+        HandleKey(window, event.code, event.action, event.mods, ctx);
+        redraw = true;
+        break;
+      case InputEvent::kScroll:
+        redraw = true;
+        printf("[SCROLL] %.3f %.3f\n", event.x, event.y);
+        if (event.y > 0) {
+          ctx->SpeedUp();
+        } else {
+          ctx->SlowDown();
+        }
+        break;
+      case InputEvent::kMouseButton:
+        // http://www.glfw.org/docs/3.0/group__buttons.html
+        printf("[MOUSE] %d %d %d\n", event.code, event.action, event.mods);
+        if (event.code == GLFW_MOUSE_BUTTON_LEFT &&
+            event.action == GLFW_PRESS) {
+          PickAt(window, ctx);
+        }
+        break;
+      case InputEvent::kCursorEnter:
+        printf("[CURSOR] %s\n", event.code == GL_TRUE ? "GL_TRUE" : "GL_FALSE");
+        break;
+      case InputEvent::kCursorPos:
+        // printf("[C_POS] %.3f %.3f\n", event.x, event.y);
+        ctx->cursor_x() = event.x;
+        ctx->cursor_y() = event.y;
+        break;
+      case InputEvent::kRefresh:
+        redraw = true;
+        break;
+    }
+  }
+  if (any) {
+    fflush(NULL);
+  }
+  return redraw;
+}
+
 int main(int argc, char* argv[]) {
   PrintHelper();
   GLFWwindow* window;
   GLContext context;
 
+  // 命令行参数
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    fprintf(stderr, "bad arguments, see usage above\n");
+    return -1;
+  }
+  context.stats_path() = options.stats;
+
+  if (options.headless) {
+    return RunHeadless(options, &context);
+  }
+
   // 初始化 glfw
   if (!glfwInit()) {
     fprintf(stderr, "GLFW3 init failed\n");
     return -1;
   }
 
-  // 初始化 SDL 的 image, 这样它可以加载 JPG, PNG 和 TIF
-  if (!IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_TIF)) {
-    fprintf(stderr, "IMG init failed: %s %s:%d\n", IMG_GetError(), __FILE__,
-            __LINE__);
+  if (!InitImageDecoder()) {
     return -1;
   }
 
+  // 要 3.3 的 core profile, 没有固定管线
+  // macOS 上 core profile 必须是 forward compatible 的
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, GL_EARTH_GL_MAJOR);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, GL_EARTH_GL_MINOR);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
   // 创建一个窗口, 宽度, 长度, 标题等
   window = glfwCreateWindow(640, 480, "My Earth", NULL, NULL);
   if (!window) {
@@ -222,8 +887,8 @@ int main(int argc, char* argv[]) {
   // http://www.glfw.org/docs/latest/group__context.html#ga1c04dc242268f827290fe40aa1c91157
   glfwMakeContextCurrent(window);
 
-  // http://www.glfw.org/docs/latest/group__context.html#ga6d4e0cdf151b5e579bd67f13202994ed
-  glfwSwapInterval(1);
+  // 帧节奏, 见 InitPacing
+  InitPacing(options, &context);
 
   // 若 GLFW 出现错误, 回调(callback) 这个窗口
   // 回调是 c 里面早就有的功能, 不过 c++11 的新的
@@ -238,175 +903,148 @@ int main(int argc, char* argv[]) {
   // http://www.glfw.org/docs/3.0/group__input.html#gaa92336e173da9c8834558b54ee80563b
   // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+  // 输入回调里只把事件塞进无锁队列, 不改状态也不打印,
+  // 由主循环在固定的位置统一处理 (DrainInput)
+  // 这样 glfwPollEvents 中间不会夹着 printf/fflush 这种系统调用
+
   // 键盘事件回调
   // http://www.glfw.org/docs/latest/group__input.html#ga7e496507126f35ea72f01b2e6ef6d155
   glfwSetKeyCallback(window, [](GLFWwindow* window, int key, int scancode,
                                 int action, int mods) {
-    // double rsec = glfwGetTime();
-    // printf("[KEY]: %c %d %d %s %s --- %.3f\n", key, key, scancode,
-    //        action == GLFW_PRESS
-    //            ? "GLFW_PRESS"
-    //            : (action == GLFW_RELEASE ? "GLFW_RELEASE" : "GLFW_REPEAT"),
-    //        KeyCallbackModParse(mods).c_str(), rsec);
-    // fflush(NULL);
-
-    // action: GLFW_PRESS 表示按下, GLFW_REPEAT 表示按着不放, 一段时间后
-    // 再次触发
     GLContext* ctx = static_cast<GLContext*>(glfwGetWindowUserPointer(window));
-    if (action == GLFW_PRESS || action == GLFW_REPEAT) {
-      switch (key) {
-        case '+':
-        case '=':
-          ctx->SpeedUp();
-          break;
-        case '-':
-        case '_':
-          ctx->SlowDown();
-          break;
-        case 'v':
-        case 'V':
-          int w;
-          int h;
-          glfwGetFramebufferSize(window, &w, &h);
-          printf("glfwGetFramebufferSize: %d %d\n", w, h);
-          fflush(NULL);
-          break;
-        case GLFW_KEY_UP:
-          ctx->EarthSizeUp();
-          break;
-        case GLFW_KEY_DOWN:
-          ctx->EarthSizeDown();
-          break;
-        case 'h':
-        case 'H':
-          glfwHideWindow(window);
-          break;
-        case 's':
-        case 'S':
-          glfwShowWindow(window);
-          break;
-        case GLFW_KEY_ESCAPE:
-        case 'q':
-        case 'Q':
-          // http://www.glfw.org/docs/latest/group__window.html#ga49c449dde2a6f87d996f4daaa09d6708
-          glfwSetWindowShouldClose(window, GL_TRUE);
-          break;
-        default:
-          // nothing
-          break;
-      }
-    }
-
+    InputEvent event = {InputEvent::kKey, key, action, mods, 0, 0};
+    ctx->input().Push(event);
   });
 
   // 滚轮事件
   // http://www.glfw.org/docs/3.0/group__input.html#gacf02eb10504352f16efda4593c3ce60e
   glfwSetScrollCallback(window, [](GLFWwindow* window, double x_axis,
                                    double y_axis) {
-    printf("[SCROLL] %.3f %.3f\n", x_axis, y_axis);
-    fflush(NULL);
     GLContext* ctx = static_cast<GLContext*>(glfwGetWindowUserPointer(window));
-    if (y_axis > 0) {
-      ctx->SpeedUp();
-    } else {
-      ctx->SlowDown();
-    }
+    InputEvent event = {InputEvent::kScroll, 0, 0, 0, x_axis, y_axis};
+    ctx->input().Push(event);
   });
 
   // 鼠标事件
   // http://www.glfw.org/docs/3.0/group__input.html#gaef49b72d84d615bca0a6ed65485e035d
   glfwSetMouseButtonCallback(
       window, [](GLFWwindow* window, int button, int action, int mods) {
-        // http://www.glfw.org/docs/3.0/group__buttons.html
-        printf("[MOUSE] %d %d %d\n", button, action, mods);
-        fflush(NULL);
+        GLContext* ctx =
+            static_cast<GLContext*>(glfwGetWindowUserPointer(window));
+        InputEvent event = {InputEvent::kMouseButton, button, action, mods, 0,
+                            0};
+        ctx->input().Push(event);
       });
 
   // 鼠标是否在我们的窗口上?
   // 进入和离开事件
   // http://www.glfw.org/docs/3.0/group__input.html#gaa299c41dd0a3d171d166354e01279e04
   glfwSetCursorEnterCallback(window, [](GLFWwindow* window, int entered) {
-    printf("[CURSOR] %s\n", entered == GL_TRUE ? "GL_TRUE" : "GL_FALSE");
-    fflush(NULL);
+    GLContext* ctx = static_cast<GLContext*>(glfwGetWindowUserPointer(window));
+    InputEvent event = {InputEvent::kCursorEnter, entered, 0, 0, 0, 0};
+    ctx->input().Push(event);
   });
 
   // 当前鼠标位置
   // http://www.glfw.org/docs/3.0/group__input.html#ga7dad39486f2c7591af7fb25134a2501d
   glfwSetCursorPosCallback(
       window, [](GLFWwindow* window, double x_coordinate, double y_coordinate) {
-        // printf("[C_POS] %.3f %.3f\n", x_coordinate, y_coordinate);
-        // fflush(NULL);
+        GLContext* ctx =
+            static_cast<GLContext*>(glfwGetWindowUserPointer(window));
+        InputEvent event = {InputEvent::kCursorPos, 0, 0, 0, x_coordinate,
+                            y_coordinate};
+        ctx->input().Push(event);
       });
 
-  // 载入材质
-  // 全局只需要载入 1 次
-  context.texture_id() = LoadTexture("../resource/earth-modified.png");
+  // 窗口的内容坏了 (被遮住后露出来等), 要重画
+  // http://www.glfw.org/docs/latest/group__window.html#ga1caf18159767e761185e49a3be019f8d
+  glfwSetWindowRefreshCallback(window, [](GLFWwindow* window) {
+    GLContext* ctx = static_cast<GLContext*>(glfwGetWindowUserPointer(window));
+    InputEvent event = {InputEvent::kRefresh, 0, 0, 0, 0, 0};
+    ctx->input().Push(event);
+  });
+
+  InitScene(options, &context);
+  FrameStats& stats = context.frame_stats();
+  double last_print = glfwGetTime();
+
+  if (options.bench) {
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    RunBench(options, width, height, [window] { glfwSwapBuffers(window); },
+             &context);
+    glfwSetWindowShouldClose(window, GL_TRUE);
+  } else {
+    // 模拟在自己的线程里按固定频率跑, 主循环只取快照来画
+    context.simulation().Start(kSimulationTick);
+  }
 
-  int csec = 0;
-  int scnt = 0;
   // 保持循环, 直到窗口被关闭
   // Loop until the user closes the window
   // http://www.glfw.org/docs/latest/group__window.html#ga24e02fbfefbb81fc45320989f8140ab5
+  // 画面不变 (速度为 0, 没有小天体) 或者窗口看不见的时候不画,
+  // 睡在 glfwWaitEventsTimeout 里等事件, 见 IdleScheduler;
+  // 这时模拟线程也停下, 有输入或者画面又会动了再叫醒
+  IdleScheduler scheduler;
   while (!glfwWindowShouldClose(window)) {
-    // 检查当前时间
-    int rsec = (int)glfwGetTime();
-    scnt++;
-    if (rsec - csec > 3) {
-      int rc = scnt / (rsec - csec);
-      fprintf(stdout, "FPS: %d (%d/%d)\n", rc, scnt, (rsec - csec));
-      fflush(stdout);
-      csec = rsec;
-      scnt = 0;
+    // 每 3 秒打印一次这段时间的帧率和分位数
+    if (glfwGetTime() - last_print > 3) {
+      stats.PrintWindow(stdout);
+      last_print = glfwGetTime();
     }
 
-    // 构造界面开始
-    float ratio;
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
-    ratio = width / (float)height;
-    glViewport(0, 0, width, height);
-
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    // glMatrixMode ref:
-    // https://www.opengl.org/sdk/docs/man2/xhtml/glMatrixMode.xml
-    glMatrixMode(GL_PROJECTION);  // Applies subsequent matrix operations to the
-                                  // projection matrix stack.
-    glLoadIdentity();
-    glOrtho(-ratio, ratio, -1.f, 1.f, 1.f, -1.f);
-    glMatrixMode(GL_MODELVIEW);  // Applies subsequent matrix operations to the
-                                 // modelview matrix stack.
-    glLoadIdentity();
-    // 此处, 我们旋转自己的 view
-    glRotatef((float)glfwGetTime() * 50.f * context.speed() + context.offset(),
-              0.f, 0.f, 1.f);
-
-    // 关于世界观, 我找了下, 这个文档可能是一个不错的说明:
-    // https://learnopengl-cn.github.io/01%20Getting%20started/08%20Coordinate%20Systems/
-
-    // 构造界面结束
-
-    // 实际上, 我做了个 tricky 的操作
-    // 太阳永远是在 0,0 即正中心,
-    // 而地球是在 (x, 0), (x + r, 0), (x, 0+r), (x + r, 0 + r)
-    // 四个点对应的正方形那儿贴的图
-    // 我旋转的其实是我们的观察视角 :)
-
-    // 画地球
-    DrawEarth(0.6f, 0.f, context.earth_size(), &context);
+    bool visible = glfwGetWindowAttrib(window, GLFW_VISIBLE) &&
+                   !glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+    Simulation& simulation = context.simulation();
+    SimState state = simulation.Sample(simulation.Now());
+    // 看不见, 或者速度为 0 又没有小天体时, 模拟推进了画面也不会变
+    bool parkable = !visible ||
+                    (state.speed == 0 && context.bodies().size() == 0);
+    if (!parkable) {
+      simulation.Resume();
+    }
+    if (scheduler.ShouldRender(glfwGetTime(), visible, !SceneSettled(&context),
+                               width, height, state,
+                               context.bodies().size() > 0)) {
+      context.pacer().Wait();
+      stats.BeginFrame();
+      RenderFrame(width, height, state, &context);
 
-    // 画太阳
-    DrawSun(0.2f, &context);
+      // Swap front and back buffers
+      // http://www.glfw.org/docs/latest/group__window.html#ga15a5a1ee5b3c2ca6b15ca209a12efd14
+      stats.BeginSwap();
+      glfwSwapBuffers(window);
+      stats.EndFrame();
+      scheduler.Rendered(width, height, state);
 
-    // Swap front and back buffers
-    // http://www.glfw.org/docs/latest/group__window.html#ga15a5a1ee5b3c2ca6b15ca209a12efd14
-    glfwSwapBuffers(window);
+      // Poll for and process events
+      // http://www.glfw.org/docs/latest/group__window.html#ga37bd57223967b4211d60ca1a0bf3c832
+      glfwPollEvents();
+    } else {
+      // 没什么可画的, 睡到有事件或者超时
+      // http://www.glfw.org/docs/latest/group__window.html#ga605a178db92f1a7f1a925563ef3ea2cf
+      stats.Idle();
+      context.pacer().Idle();
+      if (parkable) {
+        simulation.Pause();
+      }
+      glfwWaitEventsTimeout(scheduler.wait_timeout());
+    }
 
-    // Poll for and process events
-    // http://www.glfw.org/docs/latest/group__window.html#ga37bd57223967b4211d60ca1a0bf3c832
-    glfwPollEvents();
+    // 输入事件在这里统一处理
+    if (DrainInput(window, &context)) {
+      // 命令要模拟线程 tick 才会生效
+      context.simulation().Resume();
+      scheduler.Invalidate(glfwGetTime());
+    }
   }
 
   // 结束~
+  context.simulation().Stop();
+  // 显存在 context 还有效的时候释放
+  ReleaseScene(&context);
   printf("Bye!\n");
 
   // http://www.glfw.org/docs/latest/group__window.html#gacdf43e51376051d2c091662e9fe3d7b2
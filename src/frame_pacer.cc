@@ -0,0 +1,143 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace {
+
+const char* const kModeNames[] = {"vsync", "adaptive", "sleep", "off"};
+
+const double kDefaultSleepFps = 60.0;
+// margin 的范围; 一般系统的 sleep 超时在几十微秒到一两毫秒之间
+const double kMinMarginMs = 0.2;
+const double kMaxMarginMs = 4.0;
+
+double Milliseconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+}  // namespace
+
+const char* PacingModeName(PacingMode mode) { return kModeNames[mode]; }
+
+bool ParsePacingMode(const std::string& name, PacingMode* mode) {
+  for (int i = 0; i < 4; i++) {
+    if (name == kModeNames[i]) {
+      *mode = static_cast<PacingMode>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+FramePacer::FramePacer()
+    : mode_(kPacingVsync),
+      fps_(0),
+      period_ms_(0),
+      period_(0),
+      has_deadline_(false),
+      has_last_(false),
+      margin_ms_(1.0),
+      oversleep_ms_(0),
+      spin_ms_(0),
+      frames_(0),
+      late_(0) {}
+
+void FramePacer::Init(PacingMode mode, double fps, double refresh_hz) {
+  mode_ = mode;
+  fps_ = std::max(0.0, fps);
+  if (mode_ == kPacingSleep && fps_ <= 0) {
+    fps_ = kDefaultSleepFps;
+  }
+  period_ = fps_ > 0 ? std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(1.0 / fps_))
+                     : Clock::duration(0);
+  if (fps_ > 0) {
+    period_ms_ = 1000.0 / fps_;
+  } else if (mode_ != kPacingOff && refresh_hz > 0) {
+    period_ms_ = 1000.0 / refresh_hz;
+  } else {
+    period_ms_ = 0;
+  }
+  has_deadline_ = false;
+  has_last_ = false;
+}
+
+int FramePacer::swap_interval() const {
+  switch (mode_) {
+    case kPacingVsync:
+      return 1;
+    case kPacingAdaptive:
+      return -1;
+    default:
+      return 0;
+  }
+}
+
+// sleep 到 deadline - margin, 再自旋到 deadline
+void FramePacer::SleepUntil(Clock::time_point deadline) {
+  Clock::duration margin = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::milli>(margin_ms_));
+  Clock::time_point wake = deadline - margin;
+  Clock::time_point now = Clock::now();
+  if (wake > now) {
+    std::this_thread::sleep_until(wake);
+    now = Clock::now();
+    double over = Milliseconds(now - wake);
+    oversleep_ms_ = oversleep_ms_ * 0.9 + over * 0.1;
+    margin_ms_ = std::min(std::max(oversleep_ms_ * 1.5 + 0.1, kMinMarginMs),
+                          kMaxMarginMs);
+  }
+  Clock::time_point spin_begin = now;
+  while (now < deadline) {
+    std::this_thread::yield();
+    now = Clock::now();
+  }
+  spin_ms_ += Milliseconds(now - spin_begin);
+}
+
+void FramePacer::Wait() {
+  if (fps_ > 0) {
+    Clock::time_point now = Clock::now();
+    // 第一帧, 闲下来之后, 或者落后超过一帧, 都从现在重新开始
+    if (!has_deadline_ || !has_last_ || now - deadline_ > period_) {
+      deadline_ = now;
+    } else {
+      SleepUntil(deadline_);
+    }
+    deadline_ += period_;
+    has_deadline_ = true;
+  }
+
+  Clock::time_point start = Clock::now();
+  if (has_last_ && period_ms_ > 0) {
+    double interval = Milliseconds(start - last_start_);
+    error_.Add(std::fabs(interval - period_ms_));
+    if (interval > period_ms_ * 1.5) {
+      late_++;
+    }
+  }
+  last_start_ = start;
+  has_last_ = true;
+  frames_++;
+}
+
+void FramePacer::Print(FILE* fp) const {
+  fprintf(fp, "[FramePacer] %s", PacingModeName(mode_));
+  if (fps_ > 0) {
+    fprintf(fp, ", cap %.1f fps, spin %.3f ms/frame, margin %.2f ms",
+            fps_, frames_ ? spin_ms_ / frames_ : 0.0, margin_ms_);
+  }
+  fprintf(fp, "\n");
+  if (error_.count()) {
+    fprintf(fp,
+            "  error ms (target %.3f): mean %.3f p50 %.3f p99 %.3f "
+            "max %.3f, late %llu/%llu\n",
+            period_ms_, error_.mean(), error_.Percentile(0.5),
+            error_.Percentile(0.99), error_.max(),
+            static_cast<unsigned long long>(late_),
+            static_cast<unsigned long long>(error_.count()));
+  }
+  fflush(fp);
+}
@@ -0,0 +1,78 @@
+#ifndef GL_EARTH_FRAME_PACER_H_
+#define GL_EARTH_FRAME_PACER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "frame_stats.h"
+
+// 帧节奏的几种策略
+enum PacingMode {
+  kPacingVsync,     // swap interval 1, 由显示器刷新率定节奏
+  kPacingAdaptive,  // swap interval -1, 赶不上刷新时不等下一个 vsync 直接撕裂
+  kPacingSleep,     // 不等 vsync, 先 sleep 再自旋, 卡准每一帧的截止时间
+  kPacingOff,       // 不等 vsync, 除了 --fps 的上限, 能跑多快跑多快
+};
+
+const char* PacingModeName(PacingMode mode);
+bool ParsePacingMode(const std::string& name, PacingMode* mode);
+
+/**
+ * 帧节奏控制和误差统计
+ * 给了目标帧率 (--fps) 时, 每帧开始前等到这一帧的截止时间:
+ * 先 sleep 到截止时间前 margin 毫秒, 剩下的自旋 (yield) 等过去
+ * sleep 的超时会被记下来, margin 跟着调整, 所以自旋的 CPU 尽量少
+ * 落后超过一帧就重新对齐, 不追帧
+ * vsync/adaptive/off 也可以再加一个帧率上限 (比如 60Hz 的屏只要 30 帧)
+ * 误差为相邻两帧开始的间隔与目标周期之差的绝对值, 放在直方图里;
+ * 目标周期是 1/fps, 没限帧时是 1/刷新率 (不知道刷新率就不统计)
+ */
+class FramePacer {
+ public:
+  FramePacer();
+
+  // fps 为 0 表示不限帧; sleep 模式必须有目标, 没给时用 60
+  // refresh_hz 为显示器刷新率, 不知道时给 0
+  void Init(PacingMode mode, double fps, double refresh_hz);
+
+  // 这个模式需要的 swap interval
+  int swap_interval() const;
+  // 驱动不支持 swap control tear 时, adaptive 退回 vsync
+  void FallBackToVsync() { mode_ = kPacingVsync; }
+
+  // 每帧开始前调用
+  void Wait();
+  // 主循环这一轮没画, 下一帧重新对齐, 这段间隔也不算误差
+  void Idle() { has_last_ = false; }
+
+  void Print(FILE* fp) const;
+
+  PacingMode mode() const { return mode_; }
+  double fps() const { return fps_; }
+  uint64_t frames() const { return frames_; }
+  const Histogram& error_ms() const { return error_; }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  void SleepUntil(Clock::time_point deadline);
+
+  PacingMode mode_;
+  double fps_;
+  double period_ms_;  // 统计误差用的目标周期, 0 表示不统计
+  Clock::duration period_;
+  Clock::time_point deadline_;
+  Clock::time_point last_start_;
+  bool has_deadline_;
+  bool has_last_;
+  double margin_ms_;     // 提前多少醒来开始自旋
+  double oversleep_ms_;  // sleep 超时的滑动平均
+  double spin_ms_;       // 自旋的总时间
+  uint64_t frames_;
+  uint64_t late_;  // 间隔超过目标周期 1.5 倍的帧 (掉帧)
+  Histogram error_;
+};
+
+#endif  // GL_EARTH_FRAME_PACER_H_
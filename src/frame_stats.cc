@@ -0,0 +1,281 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "gl_caps.h"
+
+namespace {
+
+const double kBucketRatio = 1.02;
+const int kBucketCount = 910;  // 1us ~ 60s
+
+// GL 3.3 起 timer query 是核心功能, 之前要看 ARB_timer_query 扩展
+bool HasTimerQuery() {
+  return GLVersionAtLeast(3, 3) || HasGLExtension("GL_ARB_timer_query");
+}
+
+double Milliseconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+}  // namespace
+
+Histogram::Histogram() : buckets_(kBucketCount, 0) { Clear(); }
+
+int Histogram::Bucket(double ms) {
+  double us = ms * 1000.0;
+  if (us < 1.0) {
+    return 0;
+  }
+  int bucket = 1 + static_cast<int>(std::log(us) / std::log(kBucketRatio));
+  return std::min(bucket, kBucketCount - 1);
+}
+
+double Histogram::BucketUpper(int bucket) {
+  if (bucket == 0) {
+    return 0.001;
+  }
+  return std::pow(kBucketRatio, bucket) / 1000.0;
+}
+
+void Histogram::Add(double ms) {
+  buckets_[Bucket(ms)]++;
+  count_++;
+  sum_ += ms;
+  max_ = std::max(max_, ms);
+}
+
+void Histogram::Clear() {
+  std::fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+  sum_ = 0.0;
+  max_ = 0.0;
+}
+
+double Histogram::Percentile(double p) const {
+  if (!count_) {
+    return 0.0;
+  }
+  uint64_t target = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(count_))));
+  uint64_t seen = 0;
+  for (int i = 0; i < kBucketCount; i++) {
+    seen += buckets_[i];
+    if (seen >= target) {
+      return std::min(BucketUpper(i), max_);
+    }
+  }
+  return max_;
+}
+
+void Histogram::WriteJson(FILE* fp) const {
+  fprintf(fp,
+          "{\"count\": %llu, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, "
+          "\"p99\": %.4f, \"max\": %.4f, \"histogram\": [",
+          static_cast<unsigned long long>(count_), mean(), Percentile(0.5),
+          Percentile(0.95), Percentile(0.99), max_);
+  bool first = true;
+  for (int i = 0; i < kBucketCount; i++) {
+    if (buckets_[i]) {
+      fprintf(fp, "%s[%.4f, %llu]", first ? "" : ", ", BucketUpper(i),
+              static_cast<unsigned long long>(buckets_[i]));
+      first = false;
+    }
+  }
+  fprintf(fp, "]}");
+}
+
+FrameStats::FrameStats()
+    : gpu_timer_(false),
+      frames_(0),
+      frame_ms_(0.0),
+      idle_(false),
+      has_interval_(false),
+      window_frames_(0) {
+  memset(queries_, 0, sizeof(queries_));
+  memset(query_frame_, 0, sizeof(query_frame_));
+  memset(query_pending_, 0, sizeof(query_pending_));
+  Sample empty = {0, 0.0, 0.0, 0.0, -1.0};
+  recent_.assign(kRecentFrames, empty);
+  window_begin_ = Clock::now();
+}
+
+void FrameStats::Init() {
+  gpu_timer_ = HasTimerQuery();
+  if (gpu_timer_) {
+    glGenQueries(kQueryCount, queries_);
+  }
+  printf("[FrameStats] gpu timer: %s\n", gpu_timer_ ? "on" : "off");
+}
+
+void FrameStats::Release() {
+  if (gpu_timer_) {
+    glDeleteQueries(kQueryCount, queries_);
+  }
+  gpu_timer_ = false;
+}
+
+void FrameStats::BeginFrame() {
+  Clock::time_point now = Clock::now();
+  // 第一帧, 以及闲下来之后的第一帧, 都没有间隔
+  has_interval_ = frames_ && !idle_;
+  idle_ = false;
+  frame_ms_ = has_interval_ ? Milliseconds(now - last_begin_) : 0.0;
+  last_begin_ = now;
+  frame_begin_ = now;
+
+  if (gpu_timer_) {
+    int q = frames_ % kQueryCount;
+    // 正常情况下这个 query 早就回来了; 真没回来就只能丢掉那一帧的 GPU 数据
+    glBeginQuery(GL_TIME_ELAPSED, queries_[q]);
+    query_frame_[q] = frames_;
+    query_pending_[q] = true;
+  }
+}
+
+void FrameStats::BeginSwap() {
+  swap_begin_ = Clock::now();
+  if (gpu_timer_) {
+    glEndQuery(GL_TIME_ELAPSED);
+  }
+}
+
+void FrameStats::EndFrame() {
+  Clock::time_point now = Clock::now();
+  Sample& sample = recent_[frames_ % kRecentFrames];
+  sample.frame = frames_;
+  sample.frame_ms = frame_ms_;
+  sample.cpu_ms = Milliseconds(swap_begin_ - frame_begin_);
+  sample.swap_ms = Milliseconds(now - swap_begin_);
+  sample.gpu_ms = -1.0;
+
+  if (has_interval_) {
+    frame_.Add(sample.frame_ms);
+    window_.Add(sample.frame_ms);
+  }
+  cpu_.Add(sample.cpu_ms);
+  swap_.Add(sample.swap_ms);
+  frames_++;
+  window_frames_++;
+
+  CollectQueries();
+}
+
+// 只取已经回来的结果, 不等 GPU
+void FrameStats::CollectQueries() {
+  if (!gpu_timer_) {
+    return;
+  }
+  for (int q = 0; q < kQueryCount; q++) {
+    if (!query_pending_[q]) {
+      continue;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(queries_[q], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      continue;
+    }
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(queries_[q], GL_QUERY_RESULT, &ns);
+    query_pending_[q] = false;
+    // 第一帧里有初始化, 有的驱动 (llvmpipe) 还会给出离谱的值, 不要了
+    if (query_frame_[q] == 0) {
+      continue;
+    }
+    double ms = ns / 1e6;
+    gpu_.Add(ms);
+    Sample& sample = recent_[query_frame_[q] % kRecentFrames];
+    if (sample.frame == query_frame_[q]) {
+      sample.gpu_ms = ms;
+    }
+  }
+}
+
+void FrameStats::Print(FILE* fp) const {
+  const char* names[] = {"frame", "cpu", "swap", "gpu"};
+  const Histogram* histograms[] = {&frame_, &cpu_, &swap_, &gpu_};
+  fprintf(fp, "[FrameStats] %llu frames\n",
+          static_cast<unsigned long long>(frames_));
+  for (int i = 0; i < 4; i++) {
+    const Histogram& h = *histograms[i];
+    if (!h.count()) {
+      continue;
+    }
+    fprintf(fp,
+            "  %-5s ms: mean %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n",
+            names[i], h.mean(), h.Percentile(0.5), h.Percentile(0.95),
+            h.Percentile(0.99), h.max());
+  }
+  fflush(fp);
+}
+
+void FrameStats::PrintWindow(FILE* fp) {
+  Clock::time_point now = Clock::now();
+  if (!window_frames_) {
+    window_begin_ = now;
+    return;
+  }
+  double seconds = Milliseconds(now - window_begin_) / 1000.0;
+  fprintf(fp, "FPS: %.1f (%llu/%.1fs) p50 %.2fms p99 %.2fms max %.2fms\n",
+          seconds > 0 ? window_frames_ / seconds : 0.0,
+          static_cast<unsigned long long>(window_frames_), seconds,
+          window_.Percentile(0.5), window_.Percentile(0.99), window_.max());
+  fflush(fp);
+  window_.Clear();
+  window_frames_ = 0;
+  window_begin_ = now;
+}
+
+bool FrameStats::Export(const std::string& path) const {
+  size_t n = path.size();
+  if (n >= 4 && path.compare(n - 4, 4, ".csv") == 0) {
+    return ExportCsv(path);
+  }
+  return ExportJson(path);
+}
+
+bool FrameStats::ExportJson(const std::string& path) const {
+  FILE* fp = fopen(path.c_str(), "w");
+  if (!fp) {
+    fprintf(stderr, "open %s failed %s:%d\n", path.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  fprintf(fp, "{\n  \"frames\": %llu,\n  \"gpu_timer\": %s,\n",
+          static_cast<unsigned long long>(frames_),
+          gpu_timer_ ? "true" : "false");
+  fprintf(fp, "  \"frame_ms\": ");
+  frame_.WriteJson(fp);
+  fprintf(fp, ",\n  \"cpu_ms\": ");
+  cpu_.WriteJson(fp);
+  fprintf(fp, ",\n  \"swap_ms\": ");
+  swap_.WriteJson(fp);
+  fprintf(fp, ",\n  \"gpu_ms\": ");
+  gpu_.WriteJson(fp);
+  fprintf(fp, "\n}\n");
+  return fclose(fp) == 0;
+}
+
+bool FrameStats::ExportCsv(const std::string& path) const {
+  FILE* fp = fopen(path.c_str(), "w");
+  if (!fp) {
+    fprintf(stderr, "open %s failed %s:%d\n", path.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  fprintf(fp, "frame,frame_ms,cpu_ms,swap_ms,gpu_ms\n");
+  uint64_t first = frames_ > kRecentFrames ? frames_ - kRecentFrames : 0;
+  for (uint64_t f = first; f < frames_; f++) {
+    const Sample& s = recent_[f % kRecentFrames];
+    fprintf(fp, "%llu,%.4f,%.4f,%.4f,", static_cast<unsigned long long>(f),
+            s.frame_ms, s.cpu_ms, s.swap_ms);
+    if (s.gpu_ms >= 0) {
+      fprintf(fp, "%.4f\n", s.gpu_ms);
+    } else {
+      fprintf(fp, "\n");
+    }
+  }
+  return fclose(fp) == 0;
+}
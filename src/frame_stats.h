@@ -0,0 +1,122 @@
+#ifndef GL_EARTH_FRAME_STATS_H_
+#define GL_EARTH_FRAME_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "opengl.h"
+
+/**
+ * 对数分桶的直方图, 单位毫秒
+ * 每个桶比前一个宽 2%, 所以分位数的相对误差在 2% 以内,
+ * 而内存是固定的, 跑多久都不会涨
+ */
+class Histogram {
+ public:
+  Histogram();
+
+  void Add(double ms);
+  void Clear();
+
+  // p 取 0 ~ 1, 返回对应桶的上界
+  double Percentile(double p) const;
+
+  uint64_t count() const { return count_; }
+  double mean() const { return count_ ? sum_ / count_ : 0.0; }
+  double max() const { return max_; }
+
+  // 以 JSON 对象的形式输出
+  void WriteJson(FILE* fp) const;
+
+ private:
+  static int Bucket(double ms);
+  static double BucketUpper(int bucket);
+
+  std::vector<uint64_t> buckets_;
+  uint64_t count_;
+  double sum_;
+  double max_;
+};
+
+/**
+ * 每一帧的耗时统计
+ * frame: 相邻两帧开始的间隔
+ * cpu:   从帧开始到调用 swap 之前, 即 CPU 上准备和提交这一帧的时间
+ * swap:  glfwSwapBuffers 本身的耗时 (等 vsync 的时间也在这里)
+ * gpu:   GL_TIME_ELAPSED query 测得的 GPU 执行时间, 结果晚几帧才回来
+ * 全程的分布放在直方图里, 最近 kRecentFrames 帧的原始数据留着导出 CSV
+ */
+class FrameStats {
+ public:
+  FrameStats();
+
+  // 创建 GPU query, 需要在 GL context 创建之后调用
+  // 驱动不支持 timer query 时只统计 CPU 时间
+  void Init();
+  void Release();
+
+  // 一帧的三个时间点: 开始, swap 之前, swap 之后
+  void BeginFrame();
+  void BeginSwap();
+  void EndFrame();
+  // 主循环这一轮没画 (画面没变, 窗口看不见), 下一帧的间隔不算
+  void Idle() { idle_ = true; }
+
+  // 打印 p50/p95/p99/max 汇总
+  void Print(FILE* fp) const;
+  // 打印最近一段时间 (从上次调用起) 的帧率和分位数, 并清空这段的统计
+  // 这段时间一帧都没画就不打印
+  void PrintWindow(FILE* fp);
+
+  // 按扩展名选择格式: .csv 导出最近的逐帧数据, 其他导出 JSON 汇总
+  bool Export(const std::string& path) const;
+  bool ExportJson(const std::string& path) const;
+  bool ExportCsv(const std::string& path) const;
+
+  uint64_t frames() const { return frames_; }
+  const Histogram& frame_ms() const { return frame_; }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  static const int kQueryCount = 4;  // 给 GPU 留几帧的余量, 读结果不卡
+  static const int kRecentFrames = 4096;
+
+  struct Sample {
+    uint64_t frame;
+    double frame_ms;
+    double cpu_ms;
+    double swap_ms;
+    double gpu_ms;  // 还没回来或者不支持时为 -1
+  };
+
+  void CollectQueries();
+
+  bool gpu_timer_;
+  GLuint queries_[kQueryCount];
+  uint64_t query_frame_[kQueryCount];
+  bool query_pending_[kQueryCount];
+
+  uint64_t frames_;
+  Clock::time_point frame_begin_;
+  Clock::time_point swap_begin_;
+  Clock::time_point last_begin_;
+  Clock::time_point window_begin_;
+  double frame_ms_;
+  bool idle_;
+  bool has_interval_;  // 这一帧有没有和上一帧的间隔
+
+  Histogram frame_;
+  Histogram cpu_;
+  Histogram swap_;
+  Histogram gpu_;
+  Histogram window_;
+  uint64_t window_frames_;
+
+  std::vector<Sample> recent_;
+};
+
+#endif  // GL_EARTH_FRAME_STATS_H_
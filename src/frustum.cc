@@ -0,0 +1,290 @@
+#include "frustum.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// 一次测几个物体, 没有 SSE2 时一个一个测
+#if defined(__AVX__)
+const size_t kLanes = 8;
+#elif defined(__SSE2__)
+const size_t kLanes = 4;
+#endif
+
+#if defined(__SSE2__)
+
+// mask 的第 i 位为 1 表示 base + i 可见, 依次追加到 visible
+// 每个下标都先写进去, 可见才往前走一格; 没有分支, 可见一半时也不会猜错
+// visible 至少有 count 个, 所以多写的那一格不会越界
+inline size_t AppendVisible(unsigned mask, size_t base, uint32_t* visible,
+                            size_t n) {
+  for (size_t i = 0; i < kLanes; i++) {
+    visible[n] = static_cast<uint32_t>(base + i);
+    n += (mask >> i) & 1;
+  }
+  return n;
+}
+
+#endif
+
+#if defined(__AVX__)
+
+// 每个面的系数各自铺满一个寄存器
+struct Planes {
+  __m256 nx[6], ny[6], nz[6], w[6];
+  __m256 ax[6], ay[6], az[6];  // 法线的绝对值, 盒子用
+};
+
+void LoadPlanes(const Frustum& frustum, Planes* planes) {
+  for (int p = 0; p < 6; p++) {
+    const glm::vec4& plane = frustum.planes[p];
+    planes->nx[p] = _mm256_set1_ps(plane.x);
+    planes->ny[p] = _mm256_set1_ps(plane.y);
+    planes->nz[p] = _mm256_set1_ps(plane.z);
+    planes->w[p] = _mm256_set1_ps(plane.w);
+    planes->ax[p] = _mm256_set1_ps(std::fabs(plane.x));
+    planes->ay[p] = _mm256_set1_ps(std::fabs(plane.y));
+    planes->az[p] = _mm256_set1_ps(std::fabs(plane.z));
+  }
+}
+
+// 到面的有向距离 >= -r 就不在这个面外面; 六个面都不在外面算可见
+size_t CullSpheresSimd(const Frustum& frustum, const float* x, const float* y,
+                       const float* z, const float* radius, size_t count,
+                       uint32_t* visible) {
+  Planes planes;
+  LoadPlanes(frustum, &planes);
+  size_t n = 0;
+  for (size_t i = 0; i < count; i += kLanes) {
+    __m256 px = _mm256_loadu_ps(x + i);
+    __m256 py = _mm256_loadu_ps(y + i);
+    __m256 pz = _mm256_loadu_ps(z + i);
+    __m256 nr =
+        _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      __m256 d = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(planes.nx[p], px),
+                        _mm256_mul_ps(planes.ny[p], py)),
+          _mm256_add_ps(_mm256_mul_ps(planes.nz[p], pz), planes.w[p]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, nr, _CMP_GE_OQ));
+    }
+    n = AppendVisible(_mm256_movemask_ps(inside), i, visible, n);
+  }
+  return n;
+}
+
+// 盒子在法线方向上的投影半径是 |n| . extent
+size_t CullBoxesSimd(const Frustum& frustum, const float* x, const float* y,
+                     const float* z, const float* ex, const float* ey,
+                     const float* ez, size_t count, uint32_t* visible) {
+  Planes planes;
+  LoadPlanes(frustum, &planes);
+  size_t n = 0;
+  for (size_t i = 0; i < count; i += kLanes) {
+    __m256 px = _mm256_loadu_ps(x + i);
+    __m256 py = _mm256_loadu_ps(y + i);
+    __m256 pz = _mm256_loadu_ps(z + i);
+    __m256 qx = _mm256_loadu_ps(ex + i);
+    __m256 qy = _mm256_loadu_ps(ey + i);
+    __m256 qz = _mm256_loadu_ps(ez + i);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      __m256 d = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(planes.nx[p], px),
+                        _mm256_mul_ps(planes.ny[p], py)),
+          _mm256_add_ps(_mm256_mul_ps(planes.nz[p], pz), planes.w[p]));
+      __m256 r = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(planes.ax[p], qx),
+                        _mm256_mul_ps(planes.ay[p], qy)),
+          _mm256_mul_ps(planes.az[p], qz));
+      inside = _mm256_and_ps(
+          inside, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(),
+                                _CMP_GE_OQ));
+    }
+    n = AppendVisible(_mm256_movemask_ps(inside), i, visible, n);
+  }
+  return n;
+}
+
+#elif defined(__SSE2__)
+
+struct Planes {
+  __m128 nx[6], ny[6], nz[6], w[6];
+  __m128 ax[6], ay[6], az[6];  // 法线的绝对值, 盒子用
+};
+
+void LoadPlanes(const Frustum& frustum, Planes* planes) {
+  for (int p = 0; p < 6; p++) {
+    const glm::vec4& plane = frustum.planes[p];
+    planes->nx[p] = _mm_set1_ps(plane.x);
+    planes->ny[p] = _mm_set1_ps(plane.y);
+    planes->nz[p] = _mm_set1_ps(plane.z);
+    planes->w[p] = _mm_set1_ps(plane.w);
+    planes->ax[p] = _mm_set1_ps(std::fabs(plane.x));
+    planes->ay[p] = _mm_set1_ps(std::fabs(plane.y));
+    planes->az[p] = _mm_set1_ps(std::fabs(plane.z));
+  }
+}
+
+size_t CullSpheresSimd(const Frustum& frustum, const float* x, const float* y,
+                       const float* z, const float* radius, size_t count,
+                       uint32_t* visible) {
+  Planes planes;
+  LoadPlanes(frustum, &planes);
+  size_t n = 0;
+  for (size_t i = 0; i < count; i += kLanes) {
+    __m128 px = _mm_loadu_ps(x + i);
+    __m128 py = _mm_loadu_ps(y + i);
+    __m128 pz = _mm_loadu_ps(z + i);
+    __m128 nr = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      __m128 d = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planes.nx[p], px),
+                     _mm_mul_ps(planes.ny[p], py)),
+          _mm_add_ps(_mm_mul_ps(planes.nz[p], pz), planes.w[p]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, nr));
+    }
+    n = AppendVisible(_mm_movemask_ps(inside), i, visible, n);
+  }
+  return n;
+}
+
+size_t CullBoxesSimd(const Frustum& frustum, const float* x, const float* y,
+                     const float* z, const float* ex, const float* ey,
+                     const float* ez, size_t count, uint32_t* visible) {
+  Planes planes;
+  LoadPlanes(frustum, &planes);
+  size_t n = 0;
+  for (size_t i = 0; i < count; i += kLanes) {
+    __m128 px = _mm_loadu_ps(x + i);
+    __m128 py = _mm_loadu_ps(y + i);
+    __m128 pz = _mm_loadu_ps(z + i);
+    __m128 qx = _mm_loadu_ps(ex + i);
+    __m128 qy = _mm_loadu_ps(ey + i);
+    __m128 qz = _mm_loadu_ps(ez + i);
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      __m128 d = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planes.nx[p], px),
+                     _mm_mul_ps(planes.ny[p], py)),
+          _mm_add_ps(_mm_mul_ps(planes.nz[p], pz), planes.w[p]));
+      __m128 r = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planes.ax[p], qx),
+                     _mm_mul_ps(planes.ay[p], qy)),
+          _mm_mul_ps(planes.az[p], qz));
+      inside = _mm_and_ps(inside,
+                          _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+    }
+    n = AppendVisible(_mm_movemask_ps(inside), i, visible, n);
+  }
+  return n;
+}
+
+#endif
+
+}  // namespace
+
+Frustum ExtractFrustum(const glm::mat4& m) {
+  // glm 是列主序, 第 i 行是 (m[0][i], m[1][i], m[2][i], m[3][i])
+  glm::vec4 row[4];
+  for (int i = 0; i < 4; i++) {
+    row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  }
+  // -w <= x, y, z <= w 拆成 6 个不等式
+  Frustum frustum;
+  for (int i = 0; i < 3; i++) {
+    frustum.planes[i * 2] = row[3] + row[i];
+    frustum.planes[i * 2 + 1] = row[3] - row[i];
+  }
+  for (glm::vec4& plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+bool SphereVisible(const Frustum& frustum, const glm::vec3& center,
+                   float radius) {
+  for (const glm::vec4& plane : frustum.planes) {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BoxVisible(const Frustum& frustum, const glm::vec3& center,
+                const glm::vec3& extent) {
+  for (const glm::vec4& plane : frustum.planes) {
+    glm::vec3 normal(plane);
+    float reach = glm::dot(glm::abs(normal), extent);
+    if (glm::dot(normal, center) + plane.w < -reach) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CapVisible(const Frustum& frustum, const glm::vec3& axis,
+                float cos_angle, float sin_angle) {
+  for (const glm::vec4& plane : frustum.planes) {
+    // 法线与 axis 夹角在 θ 以内时, 球冠上有点正对着法线;
+    // 否则最远的点在球冠边上, 与法线的夹角是两者之差
+    glm::vec3 normal(plane);
+    float c = glm::dot(normal, axis);
+    float reach = 1.f;
+    if (c < cos_angle) {
+      float s = std::sqrt(std::max(0.f, 1.f - c * c));
+      reach = c * cos_angle + s * sin_angle;
+    }
+    if (reach + plane.w < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t CullSpheres(const Frustum& frustum, const float* x, const float* y,
+                   const float* z, const float* radius, size_t count,
+                   uint32_t* visible) {
+#if defined(__SSE2__)
+  size_t body = count - count % kLanes;
+  size_t n = CullSpheresSimd(frustum, x, y, z, radius, body, visible);
+#else
+  size_t body = 0;
+  size_t n = 0;
+#endif
+  for (size_t i = body; i < count; i++) {
+    if (SphereVisible(frustum, glm::vec3(x[i], y[i], z[i]), radius[i])) {
+      visible[n++] = static_cast<uint32_t>(i);
+    }
+  }
+  return n;
+}
+
+size_t CullBoxes(const Frustum& frustum, const float* x, const float* y,
+                 const float* z, const float* ex, const float* ey,
+                 const float* ez, size_t count, uint32_t* visible) {
+#if defined(__SSE2__)
+  size_t body = count - count % kLanes;
+  size_t n = CullBoxesSimd(frustum, x, y, z, ex, ey, ez, body, visible);
+#else
+  size_t body = 0;
+  size_t n = 0;
+#endif
+  for (size_t i = body; i < count; i++) {
+    if (BoxVisible(frustum, glm::vec3(x[i], y[i], z[i]),
+                   glm::vec3(ex[i], ey[i], ez[i]))) {
+      visible[n++] = static_cast<uint32_t>(i);
+    }
+  }
+  return n;
+}
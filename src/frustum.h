@@ -0,0 +1,46 @@
+#ifndef GL_EARTH_FRUSTUM_H_
+#define GL_EARTH_FRUSTUM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/**
+ * 视锥剔除
+ * 视锥的 6 个面直接从 projection * view (* model) 的行里取 (Gribb-Hartmann),
+ * 面在哪个空间取决于传进来的矩阵: 带上 model 就是模型空间
+ * 批量的版本吃结构数组 (SoA) 的包围体, 有 AVX 时一次测 8 个, SSE2 一次 4 个,
+ * 输出看得见的物体的下标, 按从小到大排好, 直接拿去画
+ */
+struct Frustum {
+  // 左右下上近远, 法线朝里, 已归一化; dot(xyz, p) + w >= 0 为在里面
+  glm::vec4 planes[6];
+};
+
+Frustum ExtractFrustum(const glm::mat4& view_projection);
+
+// 单个包围球 / 轴对齐包围盒 (中心和半边长) 是否与视锥相交 (保守, 可能误判为可见)
+bool SphereVisible(const Frustum& frustum, const glm::vec3& center,
+                   float radius);
+bool BoxVisible(const Frustum& frustum, const glm::vec3& center,
+                const glm::vec3& extent);
+
+// 单位球上以 axis 为中心, 角半径为 θ 的球冠 (cos_angle = cos θ)
+// 逐个面算球冠上离面最远的点, 比包住球冠的包围球紧得多: 大球冠的包围球
+// 总会碰到球心附近, 正交投影下视锥正好是穿过球心的一根柱子
+bool CapVisible(const Frustum& frustum, const glm::vec3& axis,
+                float cos_angle, float sin_angle);
+
+// count 个包围球, 球心 (x, y, z), 半径 radius
+// 看得见的下标依次写进 visible (至少 count 个), 返回个数
+size_t CullSpheres(const Frustum& frustum, const float* x, const float* y,
+                   const float* z, const float* radius, size_t count,
+                   uint32_t* visible);
+
+// count 个轴对齐包围盒, 中心 (x, y, z), 半边长 (ex, ey, ez)
+size_t CullBoxes(const Frustum& frustum, const float* x, const float* y,
+                 const float* z, const float* ex, const float* ey,
+                 const float* ez, size_t count, uint32_t* visible);
+
+#endif  // GL_EARTH_FRUSTUM_H_
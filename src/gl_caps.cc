@@ -0,0 +1,28 @@
+#include "gl_caps.h"
+
+#include <cstdio>
+#include <cstring>
+
+bool GLVersionAtLeast(int major, int minor) {
+  const char* version =
+      reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  int v_major = 0;
+  int v_minor = 0;
+  if (!version || sscanf(version, "%d.%d", &v_major, &v_minor) != 2) {
+    return false;
+  }
+  return v_major > major || (v_major == major && v_minor >= minor);
+}
+
+bool HasGLExtension(const char* name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++) {
+    const char* extension =
+        reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+    if (extension && strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,13 @@
+#ifndef GL_EARTH_GL_CAPS_H_
+#define GL_EARTH_GL_CAPS_H_
+
+#include "opengl.h"
+
+// 当前 context 的版本是否至少为 major.minor
+bool GLVersionAtLeast(int major, int minor);
+
+// 当前 context 是否支持某个扩展, 如 "GL_ARB_timer_query"
+// core profile 里 glGetString(GL_EXTENSIONS) 是错误, 只能用 glGetStringi 一个个取
+bool HasGLExtension(const char* name);
+
+#endif  // GL_EARTH_GL_CAPS_H_
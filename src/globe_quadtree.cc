@@ -0,0 +1,452 @@
+#include "globe_quadtree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <glm/gtx/polar_coordinates.hpp>
+
+namespace {
+
+// 每块每边的格子数
+const int kPatchSegments = 16;
+const int kGridVertices = (kPatchSegments + 1) * (kPatchSegments + 1);
+// 四条边, 每条 kPatchSegments + 1 个裙边顶点
+const int kPatchVertices = kGridVertices + 4 * (kPatchSegments + 1);
+const int kSurfaceIndices = kPatchSegments * kPatchSegments * 6;
+const int kSkirtIndices = 4 * kPatchSegments * 6;
+
+// 和以前的 UV 球一样, 每段格子在屏幕上约 kPixelsPerSegment 像素
+const float kPixelsPerSegment = 8.f;
+// 再往下分 float 的贴图坐标就不够细了
+const int kMaxDepth = 14;
+// 显存里最多留多少块, 一块 (16 + 1)^2 + 68 个顶点, 约 12.5 KB
+const int kSlotCount = 512;
+// 每帧最多生成几块的顶点, 剩下的下一帧再说, 先画父节点
+const int kBuildsPerFrame = 32;
+// 裙边的深度是一段格子长度的几倍, 够盖住差几级的邻居之间的裂缝
+const float kSkirtDepth = 2.f;
+const float kMaxSkirtDepth = 0.2f;
+// 多少帧没往下走就把孩子剪掉, 60 fps 下约 5 秒, 来回缩放不用重建
+const uint64_t kPruneFrames = 300;
+
+// 格子第 i 行第 j 列的顶点
+inline int GridIndex(int i, int j) { return i * (kPatchSegments + 1) + j; }
+
+// 第 edge 条边 (上, 下, 左, 右) 上第 k 个点对应的格子顶点
+int EdgeIndex(int edge, int k) {
+  switch (edge) {
+    case 0:
+      return GridIndex(0, k);
+    case 1:
+      return GridIndex(kPatchSegments, k);
+    case 2:
+      return GridIndex(k, 0);
+    default:
+      return GridIndex(k, kPatchSegments);
+  }
+}
+
+// 所有块共用的下标: 先是表面, 再是裙边
+// 表面和 BuildUvSphere 一样从外面看是逆时针; 裙边不剔除, 不管朝向
+void BuildIndices(std::vector<GLushort>* indices) {
+  indices->clear();
+  indices->reserve(kSurfaceIndices + kSkirtIndices);
+  for (int i = 0; i < kPatchSegments; i++) {
+    for (int j = 0; j < kPatchSegments; j++) {
+      GLushort a = static_cast<GLushort>(GridIndex(i, j));
+      GLushort b = static_cast<GLushort>(GridIndex(i + 1, j));
+      indices->push_back(a);
+      indices->push_back(b);
+      indices->push_back(b + 1);
+      indices->push_back(a);
+      indices->push_back(b + 1);
+      indices->push_back(a + 1);
+    }
+  }
+  for (int edge = 0; edge < 4; edge++) {
+    for (int k = 0; k < kPatchSegments; k++) {
+      GLushort g0 = static_cast<GLushort>(EdgeIndex(edge, k));
+      GLushort g1 = static_cast<GLushort>(EdgeIndex(edge, k + 1));
+      GLushort s0 = static_cast<GLushort>(kGridVertices +
+                                          edge * (kPatchSegments + 1) + k);
+      indices->push_back(g0);
+      indices->push_back(s0);
+      indices->push_back(s0 + 1);
+      indices->push_back(g0);
+      indices->push_back(s0 + 1);
+      indices->push_back(g1);
+    }
+  }
+}
+
+}  // namespace
+
+GlobeQuadtree::GlobeQuadtree()
+    : vao_(0), vbo_(0), ibo_(0), roots_(0), frame_(0), builds_left_(0) {}
+
+void GlobeQuadtree::Build() {
+  Release();
+
+  std::vector<GLushort> indices;
+  BuildIndices(&indices);
+
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vbo_);
+  glGenBuffers(1, &ibo_);
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glBufferData(GL_ARRAY_BUFFER, kSlotCount * kPatchVertices * sizeof(Vertex),
+               NULL, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort),
+               indices.data(), GL_STATIC_DRAW);
+  // 和 Mesh 的顶点格式一样, 普通贴图和虚拟贴图的 shader 都能直接用
+  glEnableVertexAttribArray(kPositionAttribute);
+  glVertexAttribPointer(
+      kPositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+      reinterpret_cast<const GLvoid*>(offsetof(Vertex, position)));
+  glEnableVertexAttribArray(kTexCoordAttribute);
+  glVertexAttribPointer(
+      kTexCoordAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+      reinterpret_cast<const GLvoid*>(offsetof(Vertex, tex_coord)));
+  glEnableVertexAttribArray(kColorAttribute);
+  glVertexAttribPointer(
+      kColorAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+      reinterpret_cast<const GLvoid*>(offsetof(Vertex, color)));
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  Slot empty = {-1, 0};
+  slots_.assign(kSlotCount, empty);
+  scratch_.resize(kPatchVertices);
+
+  // 两行四列, 每块 90° x 90°
+  for (int row = 0; row < 2; row++) {
+    for (int col = 0; col < 4; col++) {
+      nodes_.push_back(MakeNode(col * 0.25f, row * 0.5f, 0.25f, 0.5f, 0));
+    }
+  }
+  roots_ = static_cast<int>(nodes_.size());
+}
+
+// 块内格子顶点在单位球上的位置
+void GlobeQuadtree::PatchPositions(const Node& node, float* x, float* y,
+                                   float* z) const {
+  float lat[kGridVertices];
+  float lon[kGridVertices];
+  for (int i = 0; i <= kPatchSegments; i++) {
+    float v = node.v0 + node.dv * i / kPatchSegments;
+    for (int j = 0; j <= kPatchSegments; j++) {
+      float u = node.u0 + node.du * j / kPatchSegments;
+      lat[GridIndex(i, j)] = static_cast<float>(M_PI_2 - v * M_PI);
+      lon[GridIndex(i, j)] = static_cast<float>(u * 2 * M_PI - M_PI);
+    }
+  }
+  glm::euclidean(lat, lon, kGridVertices, x, y, z);
+}
+
+// 新建一个节点, 算好包围球, 法线锥和误差
+GlobeQuadtree::Node GlobeQuadtree::MakeNode(float u0, float v0, float du,
+                                            float dv, int depth) const {
+  Node node;
+  node.u0 = u0;
+  node.v0 = v0;
+  node.du = du;
+  node.dv = dv;
+  node.depth = depth;
+  node.children = -1;
+  node.slot = -1;
+  node.refined = 0;
+
+  // 三角形都在格子顶点的凸包里, 包住顶点就包住了整块
+  float x[kGridVertices], y[kGridVertices], z[kGridVertices];
+  PatchPositions(node, x, y, z);
+  glm::vec3 sum(0.f);
+  for (int i = 0; i < kGridVertices; i++) {
+    sum += glm::vec3(x[i], y[i], z[i]);
+  }
+  node.center = sum / static_cast<float>(kGridVertices);
+  node.axis = glm::normalize(sum);
+  node.radius = 0;
+  float min_cos = 1.f;
+  for (int i = 0; i < kGridVertices; i++) {
+    glm::vec3 p(x[i], y[i], z[i]);
+    node.radius = std::max(node.radius, glm::length(p - node.center));
+    min_cos = std::min(min_cos, glm::dot(p, node.axis));
+  }
+  node.sin_angle = std::sqrt(std::max(0.f, 1.f - min_cos * min_cos));
+  // 超过 90° 的锥用不上 sin, 直接让它永远可见
+  if (min_cos < 0) {
+    node.sin_angle = 2.f;
+  }
+
+  // 经线方向一段的长度处处一样, 纬线方向在离赤道最近的地方最长
+  float top = static_cast<float>(M_PI_2 - v0 * M_PI);
+  float bottom = static_cast<float>(M_PI_2 - (v0 + dv) * M_PI);
+  float widest = top >= 0 && bottom <= 0
+                     ? 1.f
+                     : std::cos(std::min(std::fabs(top), std::fabs(bottom)));
+  node.error = std::max(dv * static_cast<float>(M_PI),
+                        du * static_cast<float>(2 * M_PI) * widest) /
+               kPatchSegments;
+
+  return node;
+}
+
+void GlobeQuadtree::Split(int index) {
+  Node node = nodes_[index];
+  float du = node.du / 2;
+  float dv = node.dv / 2;
+  // 四个孩子连续存放, 有剪掉留下的空位就填进去, 没有再往后加
+  // (insert 会让引用失效, 所以上面拷了一份)
+  Node children[4] = {
+      MakeNode(node.u0, node.v0, du, dv, node.depth + 1),
+      MakeNode(node.u0 + du, node.v0, du, dv, node.depth + 1),
+      MakeNode(node.u0, node.v0 + dv, du, dv, node.depth + 1),
+      MakeNode(node.u0 + du, node.v0 + dv, du, dv, node.depth + 1),
+  };
+  int first;
+  if (!free_children_.empty()) {
+    first = free_children_.back();
+    free_children_.pop_back();
+    std::copy(children, children + 4, nodes_.begin() + first);
+  } else {
+    first = static_cast<int>(nodes_.size());
+    nodes_.insert(nodes_.end(), children, children + 4);
+  }
+  nodes_[index].children = first;
+}
+
+// 剪掉 kPruneFrames 帧没往下走过的子树
+void GlobeQuadtree::Prune(int index) {
+  int first = nodes_[index].children;
+  if (first < 0) {
+    return;
+  }
+  if (frame_ - nodes_[index].refined > kPruneFrames) {
+    FreeChildren(index);
+    return;
+  }
+  for (int c = first; c < first + 4; c++) {
+    Prune(c);
+  }
+}
+
+// 把孩子连同整棵子树的槽和节点都还回去
+void GlobeQuadtree::FreeChildren(int index) {
+  int first = nodes_[index].children;
+  for (int c = first; c < first + 4; c++) {
+    if (nodes_[c].children >= 0) {
+      FreeChildren(c);
+    }
+    if (nodes_[c].slot >= 0) {
+      slots_[nodes_[c].slot].node = -1;
+      nodes_[c].slot = -1;
+    }
+  }
+  nodes_[index].children = -1;
+  free_children_.push_back(first);
+}
+
+void GlobeQuadtree::Update(const glm::mat4& model, const glm::mat4& view,
+                           const glm::mat4& projection, int width,
+                           int height) {
+  frame_++;
+  builds_left_ = kBuildsPerFrame;
+  base_vertices_.clear();
+  surface_counts_.clear();
+  surface_offsets_.clear();
+  skirt_counts_.clear();
+  skirt_offsets_.clear();
+  if (!vao_) {
+    return;
+  }
+
+  Frame frame;
+  frame.mvp = projection * view * model;
+  // 带上 model, 视锥的面就在球的模型空间里
+  frame.frustum = ExtractFrustum(frame.mvp);
+  // 正交投影下, 观察者在视空间的 +z 方向, 换回球的模型空间
+  frame.view_dir = glm::normalize(glm::inverse(glm::mat3(view * model)) *
+                                  glm::vec3(0.f, 0.f, 1.f));
+  // mvp 第一 (二) 行前三列的长度是模型空间一个单位在裁剪空间 x (y) 上的长度
+  const glm::mat4& m = frame.mvp;
+  float extent_x = glm::length(glm::vec3(m[0][0], m[1][0], m[2][0]));
+  float extent_y = glm::length(glm::vec3(m[0][1], m[1][1], m[2][1]));
+  frame.extent = std::max(extent_x * width, extent_y * height) / 2.f;
+
+  for (int i = 0; i < roots_; i++) {
+    Select(i, frame);
+  }
+  for (int i = 0; i < roots_; i++) {
+    Prune(i);
+  }
+}
+
+bool GlobeQuadtree::Visible(const Node& node, const Frame& frame) const {
+  if (!SphereVisible(frame.frustum, node.center, node.radius)) {
+    return false;
+  }
+  // 法线锥整个朝后: 轴与观察方向的夹角超过 90° + θ
+  return glm::dot(node.axis, frame.view_dir) >= -node.sin_angle;
+}
+
+// 一段格子投到屏幕上有多少像素
+float GlobeQuadtree::ScreenError(const Node& node, const Frame& frame) const {
+  float w = (frame.mvp * glm::vec4(node.center, 1.f)).w;
+  if (w <= 1e-6f) {
+    return kPixelsPerSegment * 2;
+  }
+  return node.error * frame.extent / w;
+}
+
+void GlobeQuadtree::Select(int index, const Frame& frame) {
+  if (!Visible(nodes_[index], frame)) {
+    return;
+  }
+  if (nodes_[index].depth < kMaxDepth &&
+      ScreenError(nodes_[index], frame) > kPixelsPerSegment) {
+    if (nodes_[index].children < 0) {
+      Split(index);
+    }
+    nodes_[index].refined = frame_;
+    // 看得见的孩子都在显存里了才往下走, 否则这一帧先画自己,
+    // 顺便把孩子的顶点生成了, 过几帧就细化下去
+    int first = nodes_[index].children;
+    bool ready = true;
+    for (int c = first; c < first + 4; c++) {
+      if (Visible(nodes_[c], frame) && !MakeResident(c)) {
+        ready = false;
+      }
+    }
+    if (ready) {
+      for (int c = first; c < first + 4; c++) {
+        Select(c, frame);
+      }
+      return;
+    }
+  }
+  Use(index);
+}
+
+// 把节点的顶点放进显存, 已经在了就只更新 LRU
+// 这一帧的生成配额用完, 或者所有槽这一帧都在用, 返回 false
+bool GlobeQuadtree::MakeResident(int index) {
+  Node& node = nodes_[index];
+  if (node.slot >= 0) {
+    slots_[node.slot].last_used = frame_;
+    return true;
+  }
+  if (builds_left_ <= 0) {
+    return false;
+  }
+  int victim = -1;
+  for (int i = 0; i < kSlotCount; i++) {
+    if (slots_[i].node < 0) {
+      victim = i;
+      break;
+    }
+    if (slots_[i].last_used < frame_ &&
+        (victim < 0 || slots_[i].last_used < slots_[victim].last_used)) {
+      victim = i;
+    }
+  }
+  if (victim < 0) {
+    return false;
+  }
+  if (slots_[victim].node >= 0) {
+    nodes_[slots_[victim].node].slot = -1;
+  }
+  builds_left_--;
+
+  float x[kGridVertices], y[kGridVertices], z[kGridVertices];
+  PatchPositions(node, x, y, z);
+  for (int i = 0; i <= kPatchSegments; i++) {
+    float v = node.v0 + node.dv * i / kPatchSegments;
+    for (int j = 0; j <= kPatchSegments; j++) {
+      float u = node.u0 + node.du * j / kPatchSegments;
+      int g = GridIndex(i, j);
+      Vertex vertex = {{x[g], y[g], z[g]}, {u, v}, {1.f, 1.f, 1.f, 1.f}};
+      scratch_[g] = vertex;
+    }
+  }
+  // 裙边顶点是边上的顶点往球心缩一点, 贴图坐标不变
+  float keep = 1.f - std::min(node.error * kSkirtDepth, kMaxSkirtDepth);
+  for (int edge = 0; edge < 4; edge++) {
+    for (int k = 0; k <= kPatchSegments; k++) {
+      Vertex vertex = scratch_[EdgeIndex(edge, k)];
+      for (GLfloat& p : vertex.position) {
+        p *= keep;
+      }
+      scratch_[kGridVertices + edge * (kPatchSegments + 1) + k] = vertex;
+    }
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glBufferSubData(GL_ARRAY_BUFFER, victim * kPatchVertices * sizeof(Vertex),
+                  kPatchVertices * sizeof(Vertex), scratch_.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  node.slot = victim;
+  slots_[victim].node = index;
+  slots_[victim].last_used = frame_;
+  return true;
+}
+
+// 这一帧画这个节点; 根节点被淘汰过的话不管配额也要重新生成
+void GlobeQuadtree::Use(int index) {
+  if (nodes_[index].slot < 0) {
+    builds_left_ = std::max(builds_left_, 1);
+  }
+  if (!MakeResident(index)) {
+    return;
+  }
+  base_vertices_.push_back(nodes_[index].slot * kPatchVertices);
+  surface_counts_.push_back(kSurfaceIndices);
+  surface_offsets_.push_back(NULL);
+  skirt_counts_.push_back(kSkirtIndices);
+  skirt_offsets_.push_back(
+      reinterpret_cast<const GLvoid*>(kSurfaceIndices * sizeof(GLushort)));
+}
+
+void GlobeQuadtree::Draw() const {
+  if (base_vertices_.empty()) {
+    return;
+  }
+  GLsizei count = static_cast<GLsizei>(base_vertices_.size());
+  glBindVertexArray(vao_);
+  // 先画裙边, 不剔除; 再画表面, 剔除背面, 盖住裙边
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, skirt_counts_.data(),
+                                GL_UNSIGNED_SHORT, skirt_offsets_.data(),
+                                count, base_vertices_.data());
+  glEnable(GL_CULL_FACE);
+  glCullFace(GL_BACK);
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, surface_counts_.data(),
+                                GL_UNSIGNED_SHORT, surface_offsets_.data(),
+                                count, base_vertices_.data());
+  glDisable(GL_CULL_FACE);
+  glBindVertexArray(0);
+}
+
+size_t GlobeQuadtree::triangle_count() const {
+  return base_vertices_.size() * kSurfaceIndices / 3;
+}
+
+void GlobeQuadtree::Release() {
+  if (vao_) {
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &vbo_);
+    glDeleteBuffers(1, &ibo_);
+  }
+  vao_ = vbo_ = ibo_ = 0;
+  nodes_.clear();
+  free_children_.clear();
+  slots_.clear();
+  roots_ = 0;
+  base_vertices_.clear();
+  surface_counts_.clear();
+  surface_offsets_.clear();
+  skirt_counts_.clear();
+  skirt_offsets_.clear();
+}
@@ -0,0 +1,124 @@
+#ifndef GL_EARTH_GLOBE_QUADTREE_H_
+#define GL_EARTH_GLOBE_QUADTREE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "mesh.h"
+
+/**
+ * 按经纬度切块的四叉树地球 (chunked LOD)
+ * 根是 8 块 90° x 90° 的经纬度块, 每块往下一分为四,
+ * 每块都是 kPatchSegments x kPatchSegments 的格子, 参数化和 BuildUvSphere 一致,
+ * 贴图坐标是经纬度的线性函数, 所以块与块之间没有接缝
+ *
+ * 每块记下包围球, 法线锥和几何误差 (一段格子在单位球上的长度)
+ * 每帧从根往下走: 出了视锥或者整块背对观察者的扔掉,
+ * 误差投到屏幕上超过 kPixelsPerSegment 像素的再往下分
+ * 放大地球时屏幕外的块都被剔掉, 所以三角形数大致不变
+ *
+ * 所有块的顶点放在一个大 VBO 里, 每块占一个固定大小的槽, 按 LRU 淘汰,
+ * 下标所有块共用; 每帧两次 glMultiDrawElementsBaseVertex 画完
+ * 相邻块级别不同会有裂缝, 每块四边挂一圈往球心垂下去的裙边 (skirt),
+ * 先画裙边再画表面, 表面盖住裙边, 只有裂缝里露出来, 不需要深度测试
+ *
+ * 很久没往下走的子树会被剪掉, 槽和节点都还回去, 放大再缩小之后
+ * nodes_ 不会一直涨
+ */
+class GlobeQuadtree {
+ public:
+  GlobeQuadtree();
+  ~GlobeQuadtree() { Release(); }
+
+  // 建 VBO/IBO 和根节点, 需要在 GL context 创建之后调用
+  void Build();
+
+  // 选出这一帧要画的块, 每帧在 Draw 之前调用一次
+  // model 为地球的模型矩阵, 单位球; 背面剔除只支持正交投影
+  // width, height 为 viewport 的像素大小
+  void Update(const glm::mat4& model, const glm::mat4& view,
+              const glm::mat4& projection, int width, int height);
+
+  // 画 Update 选出的块, 调用前绑好 program 和贴图
+  void Draw() const;
+
+  void Release();
+
+  // 上一次 Update 选了多少块, 多少三角形 (不算裙边)
+  size_t patch_count() const { return base_vertices_.size(); }
+  size_t triangle_count() const;
+
+ private:
+  GlobeQuadtree(const GlobeQuadtree&) = delete;
+  GlobeQuadtree& operator=(const GlobeQuadtree&) = delete;
+
+  // 贴图空间里的一块: u 从经度 -180 到 180, v = 0 为北极
+  struct Node {
+    float u0;
+    float v0;
+    float du;
+    float dv;
+    int depth;
+    int children;  // 第一个孩子在 nodes_ 里的下标, 四个连续; -1 为还没分
+    int slot;      // 顶点在哪个槽, -1 为不在显存里
+    float error;   // 一段格子在单位球上的最大长度
+    glm::vec3 center;  // 包围球
+    float radius;
+    glm::vec3 axis;  // 法线锥的轴, 所有法线与它的夹角不超过 θ
+    float sin_angle;  // sin θ, 超过 90° 时为 2
+    uint64_t refined;  // 最后一次往孩子里走是哪一帧
+  };
+
+  // 一帧的视锥和观察方向, 都在球的模型空间里
+  struct Frame {
+    Frustum frustum;
+    glm::mat4 mvp;
+    glm::vec3 view_dir;
+    float extent;  // 模型空间一个单位投到屏幕上的像素数 (乘以 1/w)
+  };
+
+  Node MakeNode(float u0, float v0, float du, float dv, int depth) const;
+  void Split(int index);
+  void Prune(int index);
+  void FreeChildren(int index);
+  bool Visible(const Node& node, const Frame& frame) const;
+  float ScreenError(const Node& node, const Frame& frame) const;
+  void Select(int index, const Frame& frame);
+  bool MakeResident(int index);
+  void Use(int index);
+  void PatchPositions(const Node& node, float* x, float* y, float* z) const;
+
+  GLuint vao_;
+  GLuint vbo_;
+  GLuint ibo_;
+
+  std::vector<Node> nodes_;
+  int roots_;
+  // 剪掉的四个孩子留下的空位, 存第一个的下标, Split 优先用
+  std::vector<int> free_children_;
+
+  // 顶点槽, node 为 -1 的是空槽
+  struct Slot {
+    int node;
+    uint64_t last_used;
+  };
+  std::vector<Slot> slots_;
+  uint64_t frame_;
+  int builds_left_;  // 这一帧还能生成几块的顶点
+
+  // 这一帧选中的块, 直接喂给 glMultiDrawElementsBaseVertex
+  std::vector<GLint> base_vertices_;
+  std::vector<GLsizei> surface_counts_;
+  std::vector<const GLvoid*> surface_offsets_;
+  std::vector<GLsizei> skirt_counts_;
+  std::vector<const GLvoid*> skirt_offsets_;
+
+  // 生成顶点用的, 留着避免每块分配
+  std::vector<Vertex> scratch_;
+};
+
+#endif  // GL_EARTH_GLOBE_QUADTREE_H_
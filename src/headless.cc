@@ -0,0 +1,169 @@
+#include "headless.h"
+
+#include <cstdio>
+#include <vector>
+
+#ifdef GL_EARTH_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext()
+    : display_(NULL),
+      context_(NULL),
+      framebuffer_(0),
+      color_(0),
+      depth_(0),
+      width_(0),
+      height_(0) {}
+
+#ifdef GL_EARTH_HAVE_EGL
+
+bool HeadlessContext::Create(int width, int height) {
+  // 优先用 surfaceless 平台, 完全不需要 X11/Wayland
+  EGLDisplay display = EGL_NO_DISPLAY;
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (get_platform_display) {
+    display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                   EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  EGLint major, minor;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    fprintf(stderr, "EGL init failed %s:%d\n", __FILE__, __LINE__);
+    return false;
+  }
+  display_ = display;
+  printf("EGL %d.%d %s\n", major, minor, eglQueryString(display, EGL_VENDOR));
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    fprintf(stderr, "EGL bind OpenGL API failed %s:%d\n", __FILE__, __LINE__);
+    Destroy();
+    return false;
+  }
+
+  const EGLint config_attribs[] = {
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,  EGL_RENDERABLE_TYPE,
+      EGL_OPENGL_BIT,   EGL_RED_SIZE,     8,
+      EGL_GREEN_SIZE,   8,                EGL_BLUE_SIZE,
+      8,                EGL_ALPHA_SIZE,   8,
+      EGL_NONE};
+  EGLConfig config;
+  EGLint config_count = 0;
+  if (!eglChooseConfig(display, config_attribs, &config, 1, &config_count) ||
+      config_count == 0) {
+    fprintf(stderr, "EGL choose config failed %s:%d\n", __FILE__, __LINE__);
+    Destroy();
+    return false;
+  }
+
+  // 和窗口一样, 要 3.3 的 core profile (EGL 1.5 / EGL_KHR_create_context)
+  const EGLint context_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION,       GL_EARTH_GL_MAJOR,
+      EGL_CONTEXT_MINOR_VERSION,       GL_EARTH_GL_MINOR,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE};
+  EGLContext context =
+      eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+  if (context == EGL_NO_CONTEXT) {
+    fprintf(stderr, "EGL create context failed %s:%d\n", __FILE__, __LINE__);
+    Destroy();
+    return false;
+  }
+  context_ = context;
+
+  // 不要 surface, 直接画到下面的 FBO 里 (EGL_KHR_surfaceless_context)
+  if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    fprintf(stderr, "EGL make current failed %s:%d\n", __FILE__, __LINE__);
+    Destroy();
+    return false;
+  }
+  printf("GL %s %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+
+  width_ = width;
+  height_ = height;
+  glGenRenderbuffers(1, &color_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenRenderbuffers(1, &depth_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, color_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "framebuffer incomplete %s:%d\n", __FILE__, __LINE__);
+    Destroy();
+    return false;
+  }
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  return true;
+}
+
+void HeadlessContext::Destroy() {
+  if (!display_) {
+    return;
+  }
+  if (context_) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (framebuffer_) {
+      glDeleteFramebuffers(1, &framebuffer_);
+      glDeleteRenderbuffers(1, &color_);
+      glDeleteRenderbuffers(1, &depth_);
+    }
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display_, context_);
+  }
+  eglTerminate(display_);
+  display_ = NULL;
+  context_ = NULL;
+  framebuffer_ = color_ = depth_ = 0;
+}
+
+#else  // GL_EARTH_HAVE_EGL
+
+bool HeadlessContext::Create(int width, int height) {
+  fprintf(stderr, "built without EGL, headless mode unavailable %s:%d\n",
+          __FILE__, __LINE__);
+  return false;
+}
+
+void HeadlessContext::Destroy() {}
+
+#endif  // GL_EARTH_HAVE_EGL
+
+void HeadlessContext::Present() {
+  // 没有 swap 可以等, 用 glFinish 保证统计的是真正画完的帧
+  glFinish();
+}
+
+bool HeadlessContext::SavePpm(const std::string& path) const {
+  std::vector<unsigned char> pixels(static_cast<size_t>(width_) * height_ * 3);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+  FILE* fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    fprintf(stderr, "open %s failed %s:%d\n", path.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  fprintf(fp, "P6\n%d %d\n255\n", width_, height_);
+  // GL 的第一行在最下面
+  size_t row = static_cast<size_t>(width_) * 3;
+  bool ok = true;
+  for (int y = height_ - 1; ok && y >= 0; y--) {
+    ok = fwrite(&pixels[y * row], 1, row, fp) == row;
+  }
+  return fclose(fp) == 0 && ok;
+}
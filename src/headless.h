@@ -0,0 +1,42 @@
+#ifndef GL_EARTH_HEADLESS_H_
+#define GL_EARTH_HEADLESS_H_
+
+#include <string>
+
+#include "opengl.h"
+
+/**
+ * 无窗口的离屏渲染环境
+ * 用 EGL 的 surfaceless 平台 (Mesa llvmpipe 也支持) 建 GL context,
+ * 画到自己建的 FBO 上, 没有显示器的机器也能跑
+ * 编译时没找到 EGL 的话, Create 直接返回 false
+ */
+class HeadlessContext {
+ public:
+  HeadlessContext();
+  ~HeadlessContext() { Destroy(); }
+
+  // 创建 context 和 width x height 的 framebuffer, 并设为当前
+  bool Create(int width, int height);
+  void Destroy();
+
+  // 相当于 swap: 等这一帧真正画完
+  void Present();
+
+  // 把当前 framebuffer 存成 PPM 图片
+  bool SavePpm(const std::string& path) const;
+
+ private:
+  HeadlessContext(const HeadlessContext&) = delete;
+  HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+  void* display_;
+  void* context_;
+  GLuint framebuffer_;
+  GLuint color_;
+  GLuint depth_;
+  int width_;
+  int height_;
+};
+
+#endif  // GL_EARTH_HEADLESS_H_
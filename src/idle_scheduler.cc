@@ -0,0 +1,45 @@
+#include "idle_scheduler.h"
+
+#include <algorithm>
+
+// 静止时也每半秒醒一次, 隐藏时每秒一次
+const double IdleScheduler::kIdleWait = 0.5;
+const double IdleScheduler::kHiddenWait = 1.0;
+// 几个模拟 tick 的时间, 够命令生效
+const double IdleScheduler::kInvalidateGrace = 0.1;
+
+IdleScheduler::IdleScheduler()
+    : visible_(true),
+      drawn_(false),
+      dirty_until_(0),
+      last_width_(0),
+      last_height_(0) {}
+
+void IdleScheduler::Invalidate(double now) {
+  dirty_until_ = std::max(dirty_until_, now + kInvalidateGrace);
+}
+
+bool IdleScheduler::ShouldRender(double now, bool visible, bool loading,
+                                 int width, int height, const SimState& state,
+                                 bool time_visible) {
+  bool shown = visible && !visible_;
+  visible_ = visible;
+  if (!visible || width <= 0 || height <= 0) {
+    return false;
+  }
+  // 刚从隐藏/最小化恢复时, 后台缓冲里的内容不一定还在
+  if (!drawn_ || shown || loading || now < dirty_until_ ||
+      width != last_width_ || height != last_height_) {
+    return true;
+  }
+  return state.angle != last_state_.angle ||
+         state.earth_size != last_state_.earth_size ||
+         (time_visible && state.time != last_state_.time);
+}
+
+void IdleScheduler::Rendered(int width, int height, const SimState& state) {
+  drawn_ = true;
+  last_width_ = width;
+  last_height_ = height;
+  last_state_ = state;
+}
@@ -0,0 +1,47 @@
+#ifndef GL_EARTH_IDLE_SCHEDULER_H_
+#define GL_EARTH_IDLE_SCHEDULER_H_
+
+#include "simulation.h"
+
+/**
+ * 决定窗口主循环的这一轮要不要画
+ * 窗口隐藏或者最小化时不画; 可见时只有画面会变才画:
+ * 模拟状态 (转角, 地球大小, 有小天体时的时间) 或窗口大小和上一帧不一样,
+ * 有按键/重绘请求, 或者还有贴图在载入
+ * 不画的时候主循环阻塞在 glfwWaitEventsTimeout 里, 几乎不占 CPU;
+ * 画的时候照旧 glfwPollEvents, 由 vsync 控制节奏
+ */
+class IdleScheduler {
+ public:
+  IdleScheduler();
+
+  // 按键, 滚轮, 窗口重绘 (expose) 等要求马上画
+  // 命令发给模拟线程后要过一个 tick 才生效, 所以之后一小段时间都照画
+  void Invalidate(double now);
+
+  // visible: 窗口可见且没有最小化
+  // loading: 还有贴图在载入, 要靠每帧的 Poll 推进
+  // time_visible: 画面随模拟时间变化 (有小天体在绕)
+  bool ShouldRender(double now, bool visible, bool loading, int width,
+                    int height, const SimState& state, bool time_visible);
+
+  // 画完一帧后调用, 记下这一帧画的是什么
+  void Rendered(int width, int height, const SimState& state);
+
+  // 不画时等事件的最长时间 (秒), 超时后回到主循环打印统计之类
+  double wait_timeout() const { return visible_ ? kIdleWait : kHiddenWait; }
+
+ private:
+  static const double kIdleWait;
+  static const double kHiddenWait;
+  static const double kInvalidateGrace;
+
+  bool visible_;
+  bool drawn_;  // 画过至少一帧, last_* 有效
+  double dirty_until_;
+  int last_width_;
+  int last_height_;
+  SimState last_state_;
+};
+
+#endif  // GL_EARTH_IDLE_SCHEDULER_H_
@@ -0,0 +1,225 @@
+#include "image.h"
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef GL_EARTH_HAVE_SDL_IMAGE
+#include <SDL2/SDL_image.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "jpeg_split.h"
+
+namespace {
+
+// 内存里按 R, G, B, A 字节顺序排列的格式
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+const Uint32 kRgbaFormat = SDL_PIXELFORMAT_RGBA8888;
+#else
+const Uint32 kRgbaFormat = SDL_PIXELFORMAT_ABGR8888;
+#endif
+
+// 小图开线程不划算
+const int kMinParallelRows = 256;
+
+bool ReadFile(const std::string& path, std::vector<unsigned char>* data) {
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    fprintf(stderr, "open %s failed %s:%d\n", path.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  bool ok = size > 0;
+  if (ok) {
+    data->resize(size);
+    ok = fread(data->data(), 1, size, fp) == static_cast<size_t>(size);
+  }
+  fclose(fp);
+  if (!ok) {
+    fprintf(stderr, "read %s failed %s:%d\n", path.c_str(), __FILE__,
+            __LINE__);
+  }
+  return ok;
+}
+
+// 把 surface 的 [row_begin, row_end) 行转成 RGBA8, 写到 dst 对应的行
+// surface 的 pitch 可能比一行像素宽, 转的时候顺便排紧
+bool ConvertRows(SDL_Surface* surface, int row_begin, int row_end,
+                 unsigned char* dst) {
+  size_t row = static_cast<size_t>(surface->w) * 4;
+  const char* src = static_cast<const char*>(surface->pixels) +
+                    static_cast<size_t>(row_begin) * surface->pitch;
+  return SDL_ConvertPixels(surface->w, row_end - row_begin,
+                           surface->format->format, src, surface->pitch,
+                           kRgbaFormat, dst + row_begin * row,
+                           static_cast<int>(row)) == 0;
+}
+
+// 沿 restart marker 切开, 每个线程解一条, 转好直接写进 rgba 里自己那几行
+bool DecodeJpegStrips(const std::string& path,
+                      std::vector<unsigned char>* file, int threads,
+                      std::vector<unsigned char>* rgba, int* width,
+                      int* height) {
+  std::vector<JpegStrip> strips;
+  int w;
+  int h;
+  if (!SplitJpeg(file->data(), file->size(), threads, &w, &h, &strips)) {
+    return false;
+  }
+  // 切好之后原文件就没用了
+  std::vector<unsigned char>().swap(*file);
+  size_t row = static_cast<size_t>(w) * 4;
+  rgba->resize(row * h);
+
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < strips.size(); i++) {
+    workers.push_back(std::thread([&, i] {
+      JpegStrip& strip = strips[i];
+      SDL_RWops* rw = SDL_RWFromConstMem(strip.file.data(),
+                                         static_cast<int>(strip.file.size()));
+      SDL_Surface* img = rw ? IMG_LoadTyped_RW(rw, 1, "JPG") : NULL;
+      std::vector<unsigned char>().swap(strip.file);
+      if (!img || img->w != w || img->h < strip.skip + strip.height ||
+          !ConvertRows(img, strip.skip, strip.skip + strip.height,
+                       rgba->data() + (strip.y - strip.skip) * row)) {
+        ok = false;
+      }
+      SDL_FreeSurface(img);
+    }));
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  if (!ok) {
+    fprintf(stderr, "decode %s in %d strips failed %s:%d\n", path.c_str(),
+            static_cast<int>(strips.size()), __FILE__, __LINE__);
+    return false;
+  }
+  *width = w;
+  *height = h;
+  return true;
+}
+
+}  // namespace
+
+bool InitImageDecoder() {
+  // 初始化 SDL 的 image, 这样它可以加载 JPG, PNG 和 TIF
+  if (!IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_TIF)) {
+    fprintf(stderr, "IMG init failed: %s %s:%d\n", IMG_GetError(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  return true;
+}
+
+// 虽然引用太多第三方包不太好
+// 但是 glfw3 直接把自带的载入图给干掉了
+// 说他们要专注
+// 真是没办法
+// 因此我使用 SDL2 的库
+// https://www.libsdl.org/
+// Simple DirectMedia Layer is a cross-platform
+// development library designed to provide low level access
+// to audio, keyboard, mouse, joystick, and graphics hardware
+// via OpenGL and Direct3D. It is used by video playback
+// software, emulators, and popular games including Valve's
+// award winning catalog and many Humble Bundle games.
+bool DecodeImage(const std::string& path, int threads,
+                 std::vector<unsigned char>* rgba, int* width, int* height) {
+  std::vector<unsigned char> file;
+  if (!ReadFile(path, &file)) {
+    return false;
+  }
+  threads = std::max(1, threads);
+  if (threads > 1 &&
+      DecodeJpegStrips(path, &file, threads, rgba, width, height)) {
+    return true;
+  }
+  if (file.empty() && !ReadFile(path, &file)) {
+    return false;
+  }
+
+  // libpng 的反滤波一行依赖上一行, SDL_image 也不开放逐行的接口,
+  // PNG 等格式只能整张解, 之后转 RGBA 再分行并行
+  SDL_RWops* rw =
+      SDL_RWFromConstMem(file.data(), static_cast<int>(file.size()));
+  SDL_Surface* img = rw ? IMG_Load_RW(rw, 1) : NULL;
+  if (!img) {
+    fprintf(stderr, "IMG load %s failed: %s %s:%d\n", path.c_str(),
+            IMG_GetError(), __FILE__, __LINE__);
+    return false;
+  }
+  std::vector<unsigned char>().swap(file);
+  // SDL_ConvertPixels 不支持调色板, 这种先整张转一次
+  if (SDL_ISPIXELFORMAT_INDEXED(img->format->format)) {
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(img, kRgbaFormat, 0);
+    SDL_FreeSurface(img);
+    img = converted;
+    if (!img) {
+      fprintf(stderr, "convert %s failed %s:%d\n", path.c_str(), __FILE__,
+              __LINE__);
+      return false;
+    }
+  }
+
+  // 统一转成 RGBA, jpg 解出来是 RGB 的
+  rgba->resize(static_cast<size_t>(img->w) * img->h * 4);
+  int n = img->h < kMinParallelRows ? 1 : std::min(threads, img->h);
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> workers;
+  for (int t = 1; t < n; t++) {
+    workers.push_back(std::thread([&, t] {
+      if (!ConvertRows(img, img->h * t / n, img->h * (t + 1) / n,
+                       rgba->data())) {
+        ok = false;
+      }
+    }));
+  }
+  if (!ConvertRows(img, 0, img->h / n, rgba->data())) {
+    ok = false;
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  *width = img->w;
+  *height = img->h;
+  SDL_FreeSurface(img);
+  if (!ok) {
+    fprintf(stderr, "convert %s failed %s:%d\n", path.c_str(), __FILE__,
+            __LINE__);
+  }
+  return ok;
+}
+
+#else  // GL_EARTH_HAVE_SDL_IMAGE
+
+bool InitImageDecoder() { return true; }
+
+bool DecodeImage(const std::string& path, int threads,
+                 std::vector<unsigned char>* rgba, int* width, int* height) {
+  fprintf(stderr,
+          "cannot decode %s: built without SDL2_image, "
+          "use .ktx2/.dds textures (see earth_texc) %s:%d\n",
+          path.c_str(), __FILE__, __LINE__);
+  return false;
+}
+
+#endif  // GL_EARTH_HAVE_SDL_IMAGE
+
+bool FileStamp(const std::string& path, uint64_t* size, int64_t* mtime) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    return false;
+  }
+  *size = static_cast<uint64_t>(st.st_size);
+  *mtime = static_cast<int64_t>(st.st_mtime);
+  return true;
+}
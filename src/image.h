@@ -0,0 +1,25 @@
+#ifndef GL_EARTH_IMAGE_H_
+#define GL_EARTH_IMAGE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 初始化图片解码 (SDL_image), 全局调用一次
+// 没有 SDL_image 时 (没定义 GL_EARTH_HAVE_SDL_IMAGE) 什么也不做,
+// 只能载入 .ktx2/.dds 这种 GPU 直接能用的贴图
+bool InitImageDecoder();
+
+// 解码图片 (jpg, png, tif ...) 为紧密排列的 RGBA8 像素
+// 带 restart marker 的 JPEG 切成 threads 条并行解码 (见 SplitJpeg),
+// 其它格式整张解码, 转 RGBA 时按行分给 threads 个线程
+// 各线程都直接写进预先分配好的 rgba
+// 出错时打印原因并返回 false
+// 使用前, 全局至少 InitImageDecoder 一次
+bool DecodeImage(const std::string& path, int threads,
+                 std::vector<unsigned char>* rgba, int* width, int* height);
+
+// 文件的大小和修改时间, 用来判断各种缓存是否过期
+bool FileStamp(const std::string& path, uint64_t* size, int64_t* mtime);
+
+#endif  // GL_EARTH_IMAGE_H_
@@ -0,0 +1,88 @@
+#ifndef GL_EARTH_INPUT_QUEUE_H_
+#define GL_EARTH_INPUT_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 固定大小的无锁环形队列, 单生产者单消费者 (SPSC)
+ * head_ 只有生产者写, tail_ 只有消费者写, 不需要锁也不需要 CAS
+ * 满了就丢弃新来的元素, 生产者永远不会阻塞
+ */
+template <typename T, size_t N>
+class SpscRing {
+  static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+ public:
+  SpscRing() : head_(0), tail_(0), dropped_(0) {}
+
+  // 生产者调用, 队列满时返回 false
+  bool Push(const T& value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == N) {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+      return false;
+    }
+    buffer_[head & (N - 1)] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 消费者调用, 队列空时返回 false
+  bool Pop(T* value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *value = buffer_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  // 因为队列满而丢掉的元素个数
+  uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // 生产者和消费者各自的下标放在不同的 cache line 上, 避免 false sharing
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+  std::atomic<uint64_t> dropped_;
+  T buffer_[N];
+};
+
+/**
+ * 一条输入事件, GLFW 回调里只填这个结构体, 不做任何别的事
+ */
+struct InputEvent {
+  enum Type : uint8_t {
+    kKey,
+    kScroll,
+    kMouseButton,
+    kCursorEnter,
+    kCursorPos,
+    kRefresh,  // 窗口需要重绘 (被遮住的部分露出来了之类)
+  };
+
+  Type type;
+  int32_t code;    // 键值或者鼠标按键; 鼠标进出时为 entered
+  int32_t action;  // GLFW_PRESS, GLFW_RELEASE, GLFW_REPEAT
+  int32_t mods;
+  double x;  // 滚轮偏移或者鼠标位置
+  double y;
+};
+
+typedef SpscRing<InputEvent, 256> InputQueue;
+
+#endif  // GL_EARTH_INPUT_QUEUE_H_
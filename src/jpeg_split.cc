@@ -0,0 +1,200 @@
+#include "jpeg_split.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// 格式说明见 https://www.w3.org/Graphics/JPEG/itu-t81.pdf, B.1
+const unsigned char kSoi = 0xD8;
+const unsigned char kEoi = 0xD9;
+const unsigned char kRst0 = 0xD0;
+const unsigned char kRst7 = 0xD7;
+const unsigned char kSof0 = 0xC0;  // baseline
+const unsigned char kSof1 = 0xC1;  // extended sequential, huffman
+const unsigned char kDht = 0xC4;
+const unsigned char kSos = 0xDA;
+const unsigned char kDri = 0xDD;
+
+inline int ReadU16(const unsigned char* p) { return (p[0] << 8) | p[1]; }
+
+int Gcd(int a, int b) {
+  while (b) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+}  // namespace
+
+bool SplitJpeg(const unsigned char* data, size_t size, int parts, int* width,
+               int* height, std::vector<JpegStrip>* strips) {
+  if (size < 4 || data[0] != 0xFF || data[1] != kSoi) {
+    return false;
+  }
+
+  // 解析文件头, 直到 SOS
+  size_t sof = 0;
+  int w = 0;
+  int h = 0;
+  int components = 0;
+  int mcu_w = 8;
+  int mcu_h = 8;
+  int v_max = 1;
+  int restart = 0;
+  size_t scan = 0;
+  size_t pos = 2;
+  while (!scan) {
+    if (pos + 4 > size || data[pos] != 0xFF) {
+      return false;
+    }
+    unsigned char marker = data[pos + 1];
+    // marker 前面可以有任意多个填充的 0xFF
+    if (marker == 0xFF) {
+      pos++;
+      continue;
+    }
+    size_t length = ReadU16(data + pos + 2);
+    if (length < 2 || pos + 2 + length > size) {
+      return false;
+    }
+    const unsigned char* segment = data + pos + 4;
+    if (marker == kSof0 || marker == kSof1) {
+      if (length < 8) {
+        return false;
+      }
+      sof = pos;
+      h = ReadU16(segment + 1);
+      w = ReadU16(segment + 3);
+      components = segment[5];
+      if (components == 0 ||
+          length < 8 + 3 * static_cast<size_t>(components)) {
+        return false;
+      }
+      // 只有一个分量时 scan 是非交错的, MCU 就是一个 8x8 块
+      if (components > 1) {
+        int h_max = 1;
+        for (int c = 0; c < components; c++) {
+          unsigned char sampling = segment[6 + 3 * c + 1];
+          h_max = std::max(h_max, sampling >> 4);
+          v_max = std::max(v_max, sampling & 0xF);
+        }
+        mcu_w = 8 * h_max;
+        mcu_h = 8 * v_max;
+      }
+    } else if (marker > kSof1 && marker <= 0xCF && marker != kDht &&
+               marker != 0xC8) {
+      // progressive, 无损, 算术编码 (以及 DAC) 都不管, 0xC8 是保留的
+      return false;
+    } else if (marker == kDri) {
+      if (length != 4) {
+        return false;
+      }
+      restart = ReadU16(segment);
+    } else if (marker == kSos) {
+      // 一个 scan 只含部分分量时后面还有别的 scan, 切不了
+      if (!sof || length < 3 || segment[0] != components) {
+        return false;
+      }
+      scan = pos + 2 + length;
+    }
+    pos += 2 + length;
+  }
+  // 高度为 0 表示高度写在后面的 DNL 里, 不管
+  if (!restart || w == 0 || h == 0) {
+    return false;
+  }
+
+  // 熵编码数据里的 0xFF 后面跟 0x00 是转义, 跟 RSTn 是区间分界
+  // 记下每个区间的 [begin, end)
+  std::vector<size_t> begins(1, scan);
+  std::vector<size_t> ends;
+  pos = scan;
+  while (true) {
+    const void* ff = memchr(data + pos, 0xFF, size - pos);
+    if (!ff) {
+      return false;
+    }
+    pos = static_cast<const unsigned char*>(ff) - data;
+    if (pos + 1 >= size) {
+      return false;
+    }
+    unsigned char marker = data[pos + 1];
+    if (marker == 0x00) {
+      pos += 2;
+    } else if (marker == 0xFF) {
+      pos++;
+    } else if (marker >= kRst0 && marker <= kRst7) {
+      ends.push_back(pos);
+      begins.push_back(pos + 2);
+      pos += 2;
+    } else if (marker == kEoi) {
+      ends.push_back(pos);
+      break;
+    } else {
+      // 后面还有别的 scan 或者 DNL
+      return false;
+    }
+  }
+
+  int mcus_x = (w + mcu_w - 1) / mcu_w;
+  int mcus_y = (h + mcu_h - 1) / mcu_h;
+  int64_t total = static_cast<int64_t>(mcus_x) * mcus_y;
+  if ((total + restart - 1) / restart != static_cast<int64_t>(ends.size())) {
+    return false;
+  }
+
+  // 切口每隔 step 个 MCU 行才能同时对齐 restart 区间
+  int step = restart / Gcd(restart, mcus_x);
+  int units = (mcus_y + step - 1) / step;
+  parts = std::min(parts, units);
+  if (parts < 2) {
+    return false;
+  }
+  int overlap = v_max > 1 ? step : 0;
+
+  strips->clear();
+  strips->resize(parts);
+  for (int i = 0; i < parts; i++) {
+    int row_begin = units * i / parts * step;
+    int row_end = std::min(mcus_y, units * (i + 1) / parts * step);
+    // 实际解码的 MCU 行, 上下各多出 overlap 行
+    int decode_begin = std::max(0, row_begin - overlap);
+    int decode_end = std::min(mcus_y, row_end + overlap);
+    int64_t first = static_cast<int64_t>(decode_begin) * mcus_x / restart;
+    int64_t last =
+        (static_cast<int64_t>(decode_end) * mcus_x + restart - 1) / restart;
+
+    JpegStrip& strip = (*strips)[i];
+    strip.y = row_begin * mcu_h;
+    strip.height = std::min(h, row_end * mcu_h) - strip.y;
+    strip.skip = (row_begin - decode_begin) * mcu_h;
+    int decode_height = std::min(h, decode_end * mcu_h) - decode_begin * mcu_h;
+    size_t bytes = scan + 2;
+    for (int64_t j = first; j < last; j++) {
+      bytes += ends[j] - begins[j] + 2;
+    }
+    std::vector<unsigned char>& file = strip.file;
+    file.reserve(bytes);
+    file.assign(data, data + scan);
+    file[sof + 5] = static_cast<unsigned char>(decode_height >> 8);
+    file[sof + 6] = static_cast<unsigned char>(decode_height & 0xFF);
+    // 解码器要求 RSTn 从 RST0 开始依次循环
+    for (int64_t j = first; j < last; j++) {
+      if (j > first) {
+        file.push_back(0xFF);
+        file.push_back(
+            static_cast<unsigned char>(kRst0 + (j - first - 1) % 8));
+      }
+      file.insert(file.end(), data + begins[j], data + ends[j]);
+    }
+    file.push_back(0xFF);
+    file.push_back(kEoi);
+  }
+  *width = w;
+  *height = h;
+  return true;
+}
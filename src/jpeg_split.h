@@ -0,0 +1,26 @@
+#ifndef GL_EARTH_JPEG_SPLIT_H_
+#define GL_EARTH_JPEG_SPLIT_H_
+
+#include <cstddef>
+#include <vector>
+
+// 从一张 JPEG 里切出来的一条, 本身就是一个完整的 JPEG 文件
+struct JpegStrip {
+  int y;       // 要用的第一行在原图中的位置
+  int height;  // 要用的行数
+  int skip;    // file 解出来之后, 前面有这么多行是多解的, 不要
+  std::vector<unsigned char> file;
+};
+
+// 把 JPEG 沿 restart marker 切成最多 parts 条横条, 每条可以独立解码
+// 每个 restart 区间的 DC 预测都会重置, 所以只要切口同时落在 MCU 行和
+// restart 区间的开头, 拷一份文件头, 把 SOF 里的高度改掉, 再接上这几个
+// 区间的熵编码数据 (restart marker 重新编号) 就是一张合法的 JPEG
+// 色度有纵向下采样 (4:2:0) 时, libjpeg 的 fancy upsampling 会用到上下
+// 相邻 MCU 行的色度, 这时每条上下各多解一段, 只取中间, 结果和整张解一样
+// 只处理单个 scan 的顺序编码 (baseline/extended huffman);
+// 没有 DRI, progressive, 区间切不齐等情况返回 false, 请整张解码
+bool SplitJpeg(const unsigned char* data, size_t size, int parts, int* width,
+               int* height, std::vector<JpegStrip>* strips);
+
+#endif  // GL_EARTH_JPEG_SPLIT_H_
@@ -0,0 +1,89 @@
+#include "mesh.h"
+
+#include <cstddef>
+
+#include "shader.h"
+
+// layout 的位置要和 VertexAttribute 一致
+const char kMeshVertexShader[] =
+    GL_EARTH_GLSL_VERSION GL_EARTH_MATRIX_BLOCK
+    "uniform mat4 model;\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in vec2 tex_coord;\n"
+    "layout(location = 2) in vec4 color;\n"
+    "out vec2 uv;\n"
+    "out vec4 tint;\n"
+    "void main() {\n"
+    "  uv = tex_coord;\n"
+    // 和固定管线一样, 顶点颜色先截到 [0, 1] 再插值
+    "  tint = clamp(color, 0.0, 1.0);\n"
+    "  gl_Position = projection * view * model * vec4(position, 1.0);\n"
+    "}\n";
+
+void Mesh::Upload(GLenum mode, const std::vector<Vertex>& vertices,
+                  const std::vector<GLuint>& indices) {
+  Release();
+  mode_ = mode;
+  index_count_ = static_cast<GLsizei>(indices.size());
+
+  glGenVertexArrays(1, &vao_);
+  glGenBuffers(1, &vbo_);
+  glGenBuffers(1, &ibo_);
+
+  // VAO 会记住下面所有的 array 状态和 IBO 的绑定
+  glBindVertexArray(vao_);
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
+               vertices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+               indices.data(), GL_STATIC_DRAW);
+
+  // 绑定了 VBO 之后, 这些 pointer 的最后一个参数是 buffer 内的偏移量
+  // core profile 没有 glVertexPointer 这些固定管线的数组, 全是通用属性
+  glEnableVertexAttribArray(kPositionAttribute);
+  glVertexAttribPointer(
+      kPositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+      reinterpret_cast<const GLvoid*>(offsetof(Vertex, position)));
+  glEnableVertexAttribArray(kTexCoordAttribute);
+  glVertexAttribPointer(
+      kTexCoordAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+      reinterpret_cast<const GLvoid*>(offsetof(Vertex, tex_coord)));
+  glEnableVertexAttribArray(kColorAttribute);
+  glVertexAttribPointer(
+      kColorAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+      reinterpret_cast<const GLvoid*>(offsetof(Vertex, color)));
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Mesh::Draw() const {
+  if (!vao_) {
+    return;
+  }
+  glBindVertexArray(vao_);
+  glDrawElements(mode_, index_count_, GL_UNSIGNED_INT, 0);
+  glBindVertexArray(0);
+}
+
+void Mesh::DrawInstanced(GLsizei instances) const {
+  if (!vao_ || instances <= 0) {
+    return;
+  }
+  glBindVertexArray(vao_);
+  glDrawElementsInstanced(mode_, index_count_, GL_UNSIGNED_INT, 0, instances);
+  glBindVertexArray(0);
+}
+
+void Mesh::Release() {
+  if (vao_) {
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &vbo_);
+    glDeleteBuffers(1, &ibo_);
+  }
+  vao_ = vbo_ = ibo_ = 0;
+  index_count_ = 0;
+}
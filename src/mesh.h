@@ -0,0 +1,71 @@
+#ifndef GL_EARTH_MESH_H_
+#define GL_EARTH_MESH_H_
+
+#include <vector>
+
+#include "opengl.h"
+
+/**
+ * 顶点格式: 位置, 贴图坐标, 颜色
+ */
+struct Vertex {
+  GLfloat position[3];
+  GLfloat tex_coord[2];
+  GLfloat color[4];
+};
+
+// 顶点属性的位置, shader 里用 layout(location = ...) 对应
+enum VertexAttribute {
+  kPositionAttribute = 0,
+  kTexCoordAttribute = 1,
+  kColorAttribute = 2,
+  // 之后的位置留给各自的实例属性
+  kFirstInstanceAttribute = 3,
+};
+
+/**
+ * 常驻显存的网格 (retained mode)
+ * 顶点和下标在启动时一次性写入 VBO/IBO, 顶点格式记录在 VAO 里,
+ * 之后每帧只需要绑定 VAO, 调一次 glDrawElements
+ */
+class Mesh {
+ public:
+  Mesh() : vao_(0), vbo_(0), ibo_(0), mode_(GL_TRIANGLES), index_count_(0) {}
+  ~Mesh() { Release(); }
+
+  // 上传顶点与下标, 需要在 GL context 创建之后调用
+  // mode 为 GL_TRIANGLES, GL_TRIANGLE_FAN 等
+  void Upload(GLenum mode, const std::vector<Vertex>& vertices,
+              const std::vector<GLuint>& indices);
+
+  // 画出来
+  void Draw() const;
+
+  // 一次画 instances 个实例
+  // 每个实例的属性由调用者用 glVertexAttribDivisor 挂在 vao() 上
+  void DrawInstanced(GLsizei instances) const;
+
+  // 释放显存
+  void Release();
+
+  bool empty() const { return index_count_ == 0; }
+  GLsizei index_count() const { return index_count_; }
+  GLuint vao() const { return vao_; }
+
+ private:
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+
+  GLuint vao_;
+  GLuint vbo_;
+  GLuint ibo_;
+  GLenum mode_;
+  GLsizei index_count_;
+};
+
+// 画 Mesh 的通用 vertex shader
+// 输入是上面的三个顶点属性, 输出 uv 和 tint 给 fragment shader,
+// 位置按 Matrices 和 uniform mat4 model 变换
+extern const char kMeshVertexShader[];
+
+#endif  // GL_EARTH_MESH_H_
@@ -0,0 +1,221 @@
+#include "mipmap.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "image.h"
+
+namespace {
+
+const char kMagic[4] = {'E', 'M', 'I', 'P'};
+const uint32_t kVersion = 1;
+
+// 缓存文件头, 后面紧跟 level_count 个 LevelEntry, 然后是像素数据
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint32_t width;
+  uint32_t height;
+  uint32_t level_count;
+  uint32_t reserved;
+};
+
+struct LevelEntry {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;  // 相对于文件开头
+  uint64_t size;
+};
+
+// 2x2 box filter, 只处理 [row_begin, row_end) 这几行
+// 奇数边长时, 最后一行/列和自己平均
+void DownsampleRows(const unsigned char* src, int src_w, int src_h,
+                    unsigned char* dst, int dst_w, int row_begin,
+                    int row_end) {
+  for (int y = row_begin; y < row_end; y++) {
+    const unsigned char* r0 = src + static_cast<size_t>(2 * y) * src_w * 4;
+    const unsigned char* r1 =
+        src + static_cast<size_t>(std::min(2 * y + 1, src_h - 1)) * src_w * 4;
+    unsigned char* out = dst + static_cast<size_t>(y) * dst_w * 4;
+    for (int x = 0; x < dst_w; x++) {
+      int x0 = 2 * x * 4;
+      int x1 = std::min(2 * x + 1, src_w - 1) * 4;
+      for (int c = 0; c < 4; c++) {
+        out[x * 4 + c] = static_cast<unsigned char>(
+            (r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void BuildMipChain(const unsigned char* rgba, int width, int height,
+                   int threads, std::vector<unsigned char>* data,
+                   std::vector<MipLevel>* levels) {
+  levels->clear();
+  size_t total = 0;
+  int w = width;
+  int h = height;
+  while (true) {
+    MipLevel level = {w, h, total, static_cast<size_t>(w) * h * 4};
+    levels->push_back(level);
+    total += level.size;
+    if (w == 1 && h == 1) {
+      break;
+    }
+    w = std::max(1, w / 2);
+    h = std::max(1, h / 2);
+  }
+
+  data->resize(total);
+  memcpy(data->data(), rgba, (*levels)[0].size);
+  threads = std::max(1, threads);
+
+  for (size_t i = 1; i < levels->size(); i++) {
+    const MipLevel& src = (*levels)[i - 1];
+    const MipLevel& dst = (*levels)[i];
+    const unsigned char* src_px = data->data() + src.offset;
+    unsigned char* dst_px = data->data() + dst.offset;
+
+    // 小的级别开线程不划算
+    int n = dst.height < 64 ? 1 : std::min(threads, dst.height);
+    if (n == 1) {
+      DownsampleRows(src_px, src.width, src.height, dst_px, dst.width, 0,
+                     dst.height);
+      continue;
+    }
+    std::vector<std::thread> workers;
+    for (int t = 0; t < n; t++) {
+      int begin = dst.height * t / n;
+      int end = dst.height * (t + 1) / n;
+      workers.push_back(std::thread(DownsampleRows, src_px, src.width,
+                                    src.height, dst_px, dst.width, begin,
+                                    end));
+    }
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+  }
+}
+
+std::string MipCache::PathFor(const std::string& source) {
+  return source + ".mip";
+}
+
+bool MipCache::Open(const std::string& source) {
+  Close();
+  uint64_t source_size;
+  int64_t source_mtime;
+  if (!FileStamp(source, &source_size, &source_mtime)) {
+    return false;
+  }
+
+  int fd = open(PathFor(source).c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // mmap 之后 fd 就可以关了
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  map_ = map;
+  map_size_ = size;
+
+  const unsigned char* base = static_cast<const unsigned char*>(map);
+  FileHeader header;
+  memcpy(&header, base, sizeof(header));
+  size_t table_end =
+      sizeof(FileHeader) + sizeof(LevelEntry) * header.level_count;
+  if (memcmp(header.magic, kMagic, 4) != 0 || header.version != kVersion ||
+      header.source_size != source_size ||
+      header.source_mtime != source_mtime || header.level_count == 0 ||
+      table_end > size) {
+    Close();
+    return false;
+  }
+
+  for (uint32_t i = 0; i < header.level_count; i++) {
+    LevelEntry entry;
+    memcpy(&entry, base + sizeof(FileHeader) + i * sizeof(LevelEntry),
+           sizeof(entry));
+    if (entry.offset < table_end || entry.offset + entry.size > size) {
+      Close();
+      return false;
+    }
+    MipLevel level = {static_cast<int>(entry.width),
+                      static_cast<int>(entry.height),
+                      static_cast<size_t>(entry.offset - table_end),
+                      static_cast<size_t>(entry.size)};
+    levels_.push_back(level);
+  }
+  data_ = base + table_end;
+  data_size_ = size - table_end;
+  return true;
+}
+
+void MipCache::Close() {
+  if (map_) {
+    munmap(map_, map_size_);
+  }
+  map_ = NULL;
+  map_size_ = 0;
+  data_ = NULL;
+  data_size_ = 0;
+  levels_.clear();
+}
+
+bool MipCache::Write(const std::string& source,
+                     const std::vector<unsigned char>& data,
+                     const std::vector<MipLevel>& levels) {
+  FileHeader header;
+  memcpy(header.magic, kMagic, 4);
+  header.version = kVersion;
+  if (!FileStamp(source, &header.source_size, &header.source_mtime)) {
+    return false;
+  }
+  header.width = levels[0].width;
+  header.height = levels[0].height;
+  header.level_count = static_cast<uint32_t>(levels.size());
+  header.reserved = 0;
+
+  size_t table_end = sizeof(FileHeader) + sizeof(LevelEntry) * levels.size();
+  std::string path = PathFor(source);
+  std::string tmp = path + ".tmp";
+  FILE* fp = fopen(tmp.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  for (size_t i = 0; ok && i < levels.size(); i++) {
+    LevelEntry entry = {static_cast<uint32_t>(levels[i].width),
+                        static_cast<uint32_t>(levels[i].height),
+                        table_end + levels[i].offset, levels[i].size};
+    ok = fwrite(&entry, sizeof(entry), 1, fp) == 1;
+  }
+  ok = ok && fwrite(data.data(), 1, data.size(), fp) == data.size();
+  ok = fclose(fp) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
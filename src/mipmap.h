@@ -0,0 +1,61 @@
+#ifndef GL_EARTH_MIPMAP_H_
+#define GL_EARTH_MIPMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// mipmap 中的一级, offset 为在整条链数据中的偏移量
+struct MipLevel {
+  int width;
+  int height;
+  size_t offset;
+  size_t size;
+};
+
+// 从 RGBA8 的第 0 级生成完整的 mipmap 链 (一直到 1x1)
+// 每级用 2x2 的 box filter 缩小, 行按 threads 个线程切分并行计算
+// 所有级别连续放在 data 里, 第 0 级也会拷进去
+void BuildMipChain(const unsigned char* rgba, int width, int height,
+                   int threads, std::vector<unsigned char>* data,
+                   std::vector<MipLevel>* levels);
+
+/**
+ * 硬盘上的 mipmap 缓存
+ * 放在源图旁边 (xxx.png.mip), 记录源文件的大小和修改时间,
+ * 源图没变的话, 之后启动直接 mmap 这个文件, 不用再解码和缩小
+ */
+class MipCache {
+ public:
+  MipCache() : map_(NULL), map_size_(0), data_(NULL), data_size_(0) {}
+  ~MipCache() { Close(); }
+
+  // 源图对应的缓存路径
+  static std::string PathFor(const std::string& source);
+
+  // 以 mmap 的方式打开缓存, 缓存不存在或者过期就返回 false
+  bool Open(const std::string& source);
+  void Close();
+
+  // 把整条链写成缓存文件, 先写临时文件再 rename, 不会留下半个文件
+  static bool Write(const std::string& source,
+                    const std::vector<unsigned char>& data,
+                    const std::vector<MipLevel>& levels);
+
+  const std::vector<MipLevel>& levels() const { return levels_; }
+  const unsigned char* data() const { return data_; }
+  size_t data_size() const { return data_size_; }
+
+ private:
+  MipCache(const MipCache&) = delete;
+  MipCache& operator=(const MipCache&) = delete;
+
+  void* map_;
+  size_t map_size_;
+  const unsigned char* data_;
+  size_t data_size_;
+  std::vector<MipLevel> levels_;
+};
+
+#endif  // GL_EARTH_MIPMAP_H_
@@ -0,0 +1,27 @@
+#ifndef GL_EARTH_OPENGL_H_
+#define GL_EARTH_OPENGL_H_
+
+// OpenGL / GLFW 头文件统一从这里引入
+// VBO/VAO 等 1.1 之后的函数需要 glext.h 的声明,
+// Linux 下 libGL 直接导出了这些符号, 打开 GL_GLEXT_PROTOTYPES 即可
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES 1
+#endif
+#ifdef __APPLE__
+// macOS 的 core profile 要用 gl3.h, 里面直接就有 3.3 的函数
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#define GLFW_INCLUDE_GLEXT
+#endif
+
+#ifdef __APPLE__
+#include <GLFW/glfw3.h>
+#else  // for linux : yum install glfw* :)
+#include <GL/glfw3.h>
+#endif
+
+// 需要的 context 版本, 窗口和 headless 都按这个创建
+#define GL_EARTH_GL_MAJOR 3
+#define GL_EARTH_GL_MINOR 3
+
+#endif  // GL_EARTH_OPENGL_H_
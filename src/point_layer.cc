@@ -0,0 +1,650 @@
+#include "point_layer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/polar_coordinates.hpp>
+
+#include "mesh.h"
+#include "shader.h"
+
+namespace {
+
+const char kMagic[4] = {'E', 'P', 'T', 'S'};
+
+struct PointFileHeader {
+  char magic[4];
+  uint32_t fields;
+  uint64_t count;
+};
+
+static_assert(sizeof(PointFileHeader) == 16, "point header must be 16 bytes");
+
+// 立方体每个面切成 kCellsPerFace x kCellsPerFace 个格子, 格子大小差不多
+// 按格子排序之后同一格子的点在内存里连续, 一块的包围体就很紧
+const int kCellsPerFace = 32;
+const int kCellCount = 6 * kCellsPerFace * kCellsPerFace;
+const uint16_t kNoCell = 0xFFFF;
+static_assert(kCellCount < kNoCell, "cell id must fit in uint16_t");
+
+// 一块最多多少点, 太大剔除不够细, 太小 draw 的区间太碎
+const size_t kMaxChunkPoints = 1 << 16;
+// k-d 树的叶子里最多几个点, 再少就不值得往下分了
+const size_t kKdLeafPoints = 16;
+// 一个 GPU buffer 最多多少点 (8 字节一个, 32 MB)
+const size_t kBufferPoints = 1 << 22;
+// 每帧最多上传多少字节, 传几千万个点也不会卡住一帧
+const size_t kUploadBytesPerPoll = 16 << 20;
+// 每处理这么多点看一次要不要取消
+const size_t kCancelCheckPoints = 1 << 16;
+
+const float kPointSize = 3.f;
+const float kQuantize = 32767.f;
+
+// 点在地球表面, 背面的被地球挡住; 地球不写深度, 所以在这里扔掉
+// 扔掉的点放到裁剪空间外面, 光栅化之前就被裁掉
+const char kVertexShader[] =
+    GL_EARTH_GLSL_VERSION GL_EARTH_MATRIX_BLOCK
+    "uniform mat4 model;\n"
+    "uniform vec3 view_dir;\n"
+    "uniform vec4 tint;\n"
+    "uniform float point_size;\n"
+    "layout(location = 0) in vec4 point;\n"  // xyz 位置, w 为 value
+    "out vec4 color;\n"
+    "void main() {\n"
+    "  gl_PointSize = point_size * (0.75 + 0.5 * point.w);\n"
+    "  if (dot(point.xyz, view_dir) < 0.0) {\n"
+    "    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+    "    return;\n"
+    "  }\n"
+    "  color = vec4(tint.rgb * (0.35 + 0.65 * point.w), tint.a);\n"
+    "  gl_Position = projection * view * model * vec4(point.xyz, 1.0);\n"
+    "}\n";
+
+// 点精灵: gl_PointCoord 在点的方块里从 0 到 1, 切成圆, 边缘柔化
+const char kFragmentShader[] =
+    GL_EARTH_GLSL_VERSION
+    "in vec4 color;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "  float r = length(gl_PointCoord - vec2(0.5)) * 2.0;\n"
+    "  float alpha = 1.0 - smoothstep(0.6, 1.0, r);\n"
+    "  if (alpha <= 0.0) {\n"
+    "    discard;\n"
+    "  }\n"
+    "  frag_color = vec4(color.rgb, color.a * alpha);\n"
+    "}\n";
+
+// 一次转换多少点, 够 SIMD 吃饱, 又都留在 L1 里
+const size_t kConvertBatch = 1024;
+
+// 一批点在单位球上的坐标, 结构数组, 交给 glm::euclidean 批量转换
+struct UnitBatch {
+  float lat[kConvertBatch];
+  float lon[kConvertBatch];
+  float x[kConvertBatch];
+  float y[kConvertBatch];
+  float z[kConvertBatch];
+  bool valid[kConvertBatch];
+};
+
+// 经纬度 (角度) 转单位球上的点, 和 BuildUvSphere 一致: 极轴为 y, 经度 0 朝 +z
+// 不合法的点 valid 为 false, 坐标不用看
+void LatLonToUnit(const float* records, size_t fields, size_t n,
+                  UnitBatch* batch) {
+  for (size_t i = 0; i < n; i++) {
+    float lat = records[i * fields];
+    float lon = records[i * fields + 1];
+    batch->valid[i] = lat >= -90.f && lat <= 90.f && std::isfinite(lon);
+    if (!batch->valid[i]) {
+      lat = lon = 0;
+    } else if (std::fabs(lon) > 180.f) {
+      // 批量的 sincos 只在 |x| <= 8192 弧度内保证精度
+      lon = std::remainder(lon, 360.f);
+    }
+    batch->lat[i] = glm::radians(lat);
+    batch->lon[i] = glm::radians(lon);
+  }
+  glm::euclidean(batch->lat, batch->lon, n, batch->x, batch->y, batch->z);
+}
+
+// 点投到立方体上, 落在哪个面的哪个格子
+int CellOf(float x, float y, float z) {
+  float ax = std::fabs(x);
+  float ay = std::fabs(y);
+  float az = std::fabs(z);
+  int face;
+  float m, u, v;
+  if (ax >= ay && ax >= az) {
+    face = x > 0 ? 0 : 1;
+    m = ax, u = y, v = z;
+  } else if (ay >= az) {
+    face = y > 0 ? 2 : 3;
+    m = ay, u = x, v = z;
+  } else {
+    face = z > 0 ? 4 : 5;
+    m = az, u = x, v = y;
+  }
+  int i = static_cast<int>((u / m + 1.f) * 0.5f * kCellsPerFace);
+  int j = static_cast<int>((v / m + 1.f) * 0.5f * kCellsPerFace);
+  i = std::min(std::max(i, 0), kCellsPerFace - 1);
+  j = std::min(std::max(j, 0), kCellsPerFace - 1);
+  return (face * kCellsPerFace + i) * kCellsPerFace + j;
+}
+
+// 块在立方体哪个面上, 就按这个面的两个切向轴建 k-d 树;
+// 块里的点差不多在一个平面上, 法向那个轴切了也分不开
+void TangentAxes(const glm::vec3& axis, int* a, int* b) {
+  glm::vec3 m = glm::abs(axis);
+  int major = m.x >= m.y && m.x >= m.z ? 0 : (m.y >= m.z ? 1 : 2);
+  *a = (major + 1) % 3;
+  *b = (major + 2) % 3;
+}
+
+GLshort Quantize(float x) {
+  return static_cast<GLshort>(std::lrint(x * kQuantize));
+}
+
+}  // namespace
+
+PointLayer::PointLayer()
+    : tint_(1.f),
+      program_(0),
+      state_(kIdle),
+      cancel_(false),
+      total_points_(0),
+      value_low_(0),
+      value_high_(0),
+      has_values_(false),
+      visible_points_(0) {}
+
+PointLayer::~PointLayer() { Join(); }
+
+bool PointLayer::Load(const std::string& path, const glm::vec4& tint) {
+  Release();
+  program_ = CompileProgram("points", kVertexShader, kFragmentShader);
+  if (!program_) {
+    state_ = kFailed;
+    return false;
+  }
+  path_ = path;
+  tint_ = tint;
+  cancel_ = false;
+  start_ = std::chrono::steady_clock::now();
+  state_ = kBuilding;
+  worker_ = std::thread(&PointLayer::Build, this);
+  return true;
+}
+
+// 工作线程
+void PointLayer::Build() {
+  if (!BuildChunks()) {
+    points_.clear();
+    chunks_.clear();
+    ClearBounds();
+    buffers_.clear();
+    state_ = kFailed;
+    return;
+  }
+  state_ = kUploading;
+}
+
+// 读文件, 按格子做计数排序, 切块, 分配 buffer
+// 几千万个点不想存两份, 所以转换做两遍: 第一遍只记格子, 第二遍才写顶点
+bool PointLayer::BuildChunks() {
+  int fd = open(path_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "%s: cannot open point file %s:%d\n", path_.c_str(),
+            __FILE__, __LINE__);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(PointFileHeader)) {
+    close(fd);
+    fprintf(stderr, "%s: bad point file %s:%d\n", path_.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "%s: mmap failed %s:%d\n", path_.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  const unsigned char* file = static_cast<const unsigned char*>(map);
+  PointFileHeader header;
+  memcpy(&header, file, sizeof(header));
+  size_t payload = size - sizeof(header);
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      (header.fields != 2 && header.fields != 3) ||
+      header.count > payload / (header.fields * sizeof(float))) {
+    munmap(map, size);
+    fprintf(stderr, "%s: bad point file %s:%d\n", path_.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  const float* records =
+      reinterpret_cast<const float*>(file + sizeof(header));
+  size_t count = static_cast<size_t>(header.count);
+  size_t fields = header.fields;
+
+  // 第一遍: 每个点落在哪个格子, 每个格子几个点, value 的范围
+  std::vector<uint16_t> cells(count);
+  std::vector<size_t> offsets(kCellCount + 1, 0);
+  float low = std::numeric_limits<float>::max();
+  float high = -low;
+  std::unique_ptr<UnitBatch> batch(new UnitBatch);
+  for (size_t base = 0; base < count; base += kConvertBatch) {
+    if (base % kCancelCheckPoints == 0 && cancel_) {
+      munmap(map, size);
+      return false;
+    }
+    size_t n = std::min(kConvertBatch, count - base);
+    LatLonToUnit(records + base * fields, fields, n, batch.get());
+    for (size_t k = 0; k < n; k++) {
+      size_t i = base + k;
+      if (!batch->valid[k]) {
+        cells[i] = kNoCell;
+        continue;
+      }
+      cells[i] = static_cast<uint16_t>(
+          CellOf(batch->x[k], batch->y[k], batch->z[k]));
+      offsets[cells[i] + 1]++;
+      const float* record = records + i * fields;
+      if (fields == 3 && std::isfinite(record[2])) {
+        low = std::min(low, record[2]);
+        high = std::max(high, record[2]);
+      }
+    }
+  }
+  for (int c = 0; c < kCellCount; c++) {
+    offsets[c + 1] += offsets[c];
+  }
+
+  // 第二遍: 按格子散开, 压成 short
+  // 没有 value 或者 value 都一样时当作 1
+  float scale = high > low ? 1.f / (high - low) : 0.f;
+  has_values_ = fields == 3 && scale > 0;
+  value_low_ = low;
+  value_high_ = high;
+  points_.resize(offsets[kCellCount]);
+  std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+  for (size_t base = 0; base < count; base += kConvertBatch) {
+    if (base % kCancelCheckPoints == 0 && cancel_) {
+      munmap(map, size);
+      return false;
+    }
+    size_t n = std::min(kConvertBatch, count - base);
+    LatLonToUnit(records + base * fields, fields, n, batch.get());
+    for (size_t k = 0; k < n; k++) {
+      size_t i = base + k;
+      if (cells[i] == kNoCell) {
+        continue;
+      }
+      const float* record = records + i * fields;
+      float value = 1.f;
+      if (fields == 3 && scale > 0 && std::isfinite(record[2])) {
+        value = (record[2] - low) * scale;
+      }
+      PointVertex& vertex = points_[cursor[cells[i]]++];
+      vertex.position[0] = Quantize(batch->x[k]);
+      vertex.position[1] = Quantize(batch->y[k]);
+      vertex.position[2] = Quantize(batch->z[k]);
+      vertex.position[3] = Quantize(value);
+    }
+  }
+  munmap(map, size);
+  std::vector<uint16_t>().swap(cells);
+
+  // 切块, 算包围体, 依次装进 buffer
+  for (int c = 0; c < kCellCount; c++) {
+    for (size_t first = offsets[c]; first < offsets[c + 1];
+         first += kMaxChunkPoints) {
+      size_t n = std::min(kMaxChunkPoints, offsets[c + 1] - first);
+      glm::vec3 sum(0.f);
+      for (size_t i = first; i < first + n; i++) {
+        const GLshort* q = points_[i].position;
+        sum += glm::vec3(q[0], q[1], q[2]) / kQuantize;
+      }
+      Chunk chunk;
+      glm::vec3 center = sum / static_cast<float>(n);
+      chunk.axis = glm::normalize(sum);
+      float radius = 0;
+      float min_cos = 1.f;
+      for (size_t i = first; i < first + n; i++) {
+        const GLshort* q = points_[i].position;
+        glm::vec3 p = glm::vec3(q[0], q[1], q[2]) / kQuantize;
+        radius = std::max(radius, glm::length(p - center));
+        min_cos = std::min(min_cos, glm::dot(glm::normalize(p), chunk.axis));
+      }
+      bound_x_.push_back(center.x);
+      bound_y_.push_back(center.y);
+      bound_z_.push_back(center.z);
+      bound_radius_.push_back(radius);
+      chunk.sin_angle = std::sqrt(std::max(0.f, 1.f - min_cos * min_cos));
+      // 超过 90° 的锥用不上 sin, 直接让它永远可见
+      if (min_cos < 0) {
+        chunk.sin_angle = 2.f;
+      }
+
+      if (buffers_.empty() || buffers_.back().count + n > kBufferPoints) {
+        Buffer buffer = {0, 0, first, 0, 0};
+        buffers_.push_back(buffer);
+      }
+      Buffer& buffer = buffers_.back();
+      chunk.buffer = static_cast<int>(buffers_.size()) - 1;
+      chunk.first = first - buffer.first;
+      chunk.count = static_cast<GLsizei>(n);
+      buffer.count += n;
+      chunks_.push_back(chunk);
+    }
+  }
+  total_points_ = points_.size();
+  return BuildKdTrees();
+}
+
+// 每块各自排成 k-d 树, 块之间互不相干, 按块分给几个线程
+bool PointLayer::BuildKdTrees() {
+  std::atomic<size_t> next(0);
+  auto work = [this, &next]() {
+    for (size_t c = next++; c < chunks_.size() && !cancel_; c = next++) {
+      const Chunk& chunk = chunks_[c];
+      int axis, other;
+      TangentAxes(chunk.axis, &axis, &other);
+      BuildKdTree(&points_[buffers_[chunk.buffer].first + chunk.first],
+                  chunk.count, axis, other);
+    }
+  };
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threads; i++) {
+    workers.push_back(std::thread(work));
+  }
+  work();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  return !cancel_;
+}
+
+void PointLayer::BuildKdTree(PointVertex* first, size_t n, int axis,
+                             int other) {
+  while (n > kKdLeafPoints) {
+    size_t mid = n / 2;
+    std::nth_element(first, first + mid, first + n,
+                     [axis](const PointVertex& a, const PointVertex& b) {
+                       return a.position[axis] < b.position[axis];
+                     });
+    BuildKdTree(first, mid, other, axis);
+    // 右半边接着循环, 少一层递归
+    first += mid + 1;
+    n -= mid + 1;
+    std::swap(axis, other);
+  }
+}
+
+void PointLayer::SearchKdTree(const PointVertex* first, size_t n, int axis,
+                              int other, const glm::vec3& q, float* best_d2,
+                              const PointVertex** best) {
+  if (n <= kKdLeafPoints) {
+    for (size_t i = 0; i < n; i++) {
+      const GLshort* p = first[i].position;
+      glm::vec3 d = glm::vec3(p[0], p[1], p[2]) - q;
+      float d2 = glm::dot(d, d);
+      if (d2 < *best_d2) {
+        *best_d2 = d2;
+        *best = first + i;
+      }
+    }
+    return;
+  }
+  size_t mid = n / 2;
+  const GLshort* p = first[mid].position;
+  glm::vec3 d = glm::vec3(p[0], p[1], p[2]) - q;
+  float d2 = glm::dot(d, d);
+  if (d2 < *best_d2) {
+    *best_d2 = d2;
+    *best = first + mid;
+  }
+  // 先找 q 所在的一半, 到切面的距离比当前最近的还近才看另一半
+  float delta = q[axis] - p[axis];
+  const PointVertex* left = first;
+  const PointVertex* right = first + mid + 1;
+  size_t right_n = n - mid - 1;
+  if (delta < 0) {
+    SearchKdTree(left, mid, other, axis, q, best_d2, best);
+    if (delta * delta < *best_d2) {
+      SearchKdTree(right, right_n, other, axis, q, best_d2, best);
+    }
+  } else {
+    SearchKdTree(right, right_n, other, axis, q, best_d2, best);
+    if (delta * delta < *best_d2) {
+      SearchKdTree(left, mid, other, axis, q, best_d2, best);
+    }
+  }
+}
+
+bool PointLayer::Pick(const glm::vec3& p, float max_distance,
+                      PointPick* pick) const {
+  if (state_ != kUploading && state_ != kReady) {
+    return false;
+  }
+  // 树里是量化后的坐标, 查询点和距离也换到同样的单位
+  glm::vec3 q = p * kQuantize;
+  float best_d2 = max_distance * kQuantize * max_distance * kQuantize;
+  const PointVertex* best = NULL;
+  for (size_t c = 0; c < chunks_.size(); c++) {
+    // 到包围球的距离都比当前最近的远, 整块跳过
+    glm::vec3 center(bound_x_[c], bound_y_[c], bound_z_[c]);
+    float gap = (glm::length(p - center) - bound_radius_[c]) * kQuantize;
+    if (gap > 0 && gap * gap >= best_d2) {
+      continue;
+    }
+    const Chunk& chunk = chunks_[c];
+    int axis, other;
+    TangentAxes(chunk.axis, &axis, &other);
+    SearchKdTree(&points_[buffers_[chunk.buffer].first + chunk.first],
+                 chunk.count, axis, other, q, &best_d2, &best);
+  }
+  if (!best) {
+    return false;
+  }
+  glm::vec3 position =
+      glm::vec3(best->position[0], best->position[1], best->position[2]) /
+      kQuantize;
+  glm::vec3 polar = glm::polar(position);
+  pick->lat = glm::degrees(polar.x);
+  pick->lon = glm::degrees(polar.y);
+  pick->value = has_values_ ? value_low_ + best->position[3] / kQuantize *
+                                                (value_high_ - value_low_)
+                            : std::numeric_limits<float>::quiet_NaN();
+  pick->distance = std::sqrt(best_d2) / kQuantize;
+  return true;
+}
+
+void PointLayer::Poll() {
+  if (state_ != kUploading) {
+    return;
+  }
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+
+  size_t budget = kUploadBytesPerPoll / sizeof(PointVertex);
+  bool done = true;
+  for (Buffer& buffer : buffers_) {
+    if (buffer.uploaded == buffer.count) {
+      continue;
+    }
+    if (budget == 0) {
+      done = false;
+      break;
+    }
+    if (!buffer.vbo) {
+      glGenVertexArrays(1, &buffer.vao);
+      glGenBuffers(1, &buffer.vbo);
+      glBindVertexArray(buffer.vao);
+      glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+      glBufferData(GL_ARRAY_BUFFER, buffer.count * sizeof(PointVertex), NULL,
+                   GL_STATIC_DRAW);
+      glEnableVertexAttribArray(kPositionAttribute);
+      glVertexAttribPointer(kPositionAttribute, 4, GL_SHORT, GL_TRUE,
+                            sizeof(PointVertex), NULL);
+      glBindVertexArray(0);
+    } else {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+    }
+    size_t n = std::min(budget, buffer.count - buffer.uploaded);
+    glBufferSubData(GL_ARRAY_BUFFER, buffer.uploaded * sizeof(PointVertex),
+                    n * sizeof(PointVertex),
+                    &points_[buffer.first + buffer.uploaded]);
+    buffer.uploaded += n;
+    budget -= n;
+    if (buffer.uploaded < buffer.count) {
+      done = false;
+    }
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  if (!done) {
+    return;
+  }
+
+  // 内存里的点留着给 Pick 用
+  state_ = kReady;
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start_)
+                  .count();
+  printf("[PointLayer] %s: %zu points, %zu chunks, %zu buffers, %.0f ms\n",
+         path_.c_str(), total_points_, chunks_.size(), buffers_.size(), ms);
+}
+
+void PointLayer::Draw(const glm::mat4& model, const glm::mat4& view,
+                      const glm::mat4& projection) {
+  visible_points_ = 0;
+  if (state_ != kUploading && state_ != kReady) {
+    return;
+  }
+
+  // 正交投影下, 观察者在视空间的 +z 方向, 换回球的模型空间
+  glm::vec3 view_dir = glm::normalize(glm::inverse(glm::mat3(view * model)) *
+                                      glm::vec3(0.f, 0.f, 1.f));
+  // 包围球先批量过一遍视锥, 剩下的下标从小到大, 还是按 buffer 排好的
+  Frustum frustum = ExtractFrustum(projection * view * model);
+  visible_.resize(chunks_.size());
+  size_t visible_count =
+      CullSpheres(frustum, bound_x_.data(), bound_y_.data(), bound_z_.data(),
+                  bound_radius_.data(), chunks_.size(), visible_.data());
+
+  glUseProgram(program_);
+  glUniformMatrix4fv(glGetUniformLocation(program_, "model"), 1, GL_FALSE,
+                     glm::value_ptr(model));
+  glUniform3fv(glGetUniformLocation(program_, "view_dir"), 1,
+               glm::value_ptr(view_dir));
+  glUniform4fv(glGetUniformLocation(program_, "tint"), 1,
+               glm::value_ptr(tint_));
+  glUniform1f(glGetUniformLocation(program_, "point_size"), kPointSize);
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  // 块是按 buffer 顺序排的, 换 buffer 时把攒下的区间画掉
+  int current = -1;
+  for (size_t v = 0; v < visible_count; v++) {
+    const Chunk& chunk = chunks_[visible_[v]];
+    if (chunk.buffer != current) {
+      if (current >= 0) {
+        DrawRanges(buffers_[current]);
+      }
+      current = chunk.buffer;
+    }
+    // 还没传完
+    if (chunk.first + chunk.count > buffers_[current].uploaded) {
+      continue;
+    }
+    // 法线锥整个朝后: 轴与观察方向的夹角超过 90° + θ
+    if (glm::dot(chunk.axis, view_dir) < -chunk.sin_angle) {
+      continue;
+    }
+    GLint first = static_cast<GLint>(chunk.first);
+    if (!counts_.empty() && firsts_.back() + counts_.back() == first) {
+      counts_.back() += chunk.count;
+    } else {
+      firsts_.push_back(first);
+      counts_.push_back(chunk.count);
+    }
+    visible_points_ += chunk.count;
+  }
+  if (current >= 0) {
+    DrawRanges(buffers_[current]);
+  }
+
+  glDisable(GL_BLEND);
+  glDisable(GL_PROGRAM_POINT_SIZE);
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
+
+// 一个 buffer 里可见的区间一次画完
+void PointLayer::DrawRanges(const Buffer& buffer) {
+  if (counts_.empty()) {
+    return;
+  }
+  glBindVertexArray(buffer.vao);
+  glMultiDrawArrays(GL_POINTS, firsts_.data(), counts_.data(),
+                    static_cast<GLsizei>(counts_.size()));
+  firsts_.clear();
+  counts_.clear();
+}
+
+void PointLayer::ClearBounds() {
+  bound_x_.clear();
+  bound_y_.clear();
+  bound_z_.clear();
+  bound_radius_.clear();
+}
+
+void PointLayer::Join() {
+  cancel_ = true;
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void PointLayer::Release() {
+  Join();
+  for (Buffer& buffer : buffers_) {
+    if (buffer.vao) {
+      glDeleteVertexArrays(1, &buffer.vao);
+    }
+    if (buffer.vbo) {
+      glDeleteBuffers(1, &buffer.vbo);
+    }
+  }
+  if (program_) {
+    glDeleteProgram(program_);
+  }
+  program_ = 0;
+  std::vector<PointVertex>().swap(points_);
+  chunks_.clear();
+  ClearBounds();
+  buffers_.clear();
+  total_points_ = 0;
+  visible_points_ = 0;
+  state_ = kIdle;
+}
@@ -0,0 +1,155 @@
+#ifndef GL_EARTH_POINT_LAYER_H_
+#define GL_EARTH_POINT_LAYER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "opengl.h"
+
+// Pick 找到的点
+struct PointPick {
+  float lat;  // 角度, 从量化后的位置算回来, 误差约 0.002°
+  float lon;
+  float value;  // 文件里的 value, 没有时为 NaN
+  float distance;  // 到查询点的距离, 单位球上
+};
+
+/**
+ * 点图层: 在地球上画几千万个经纬度点 (事件数据之类)
+ *
+ * 文件格式 (小端):
+ *   char     magic[4] = "EPTS"
+ *   uint32_t fields      2 为 (lat, lon), 3 为 (lat, lon, value)
+ *   uint64_t count
+ *   float    records[count][fields]   纬度/经度为角度
+ *
+ * 工作线程 mmap 文件, 把点转成球面坐标, 按立方体贴图的格子做计数排序,
+ * 同一格子的点连续存放, 再切成不超过 kMaxChunkPoints 的块 (chunk),
+ * 每块记下包围球和法线锥; 顶点压成 4 个 short, 一个点 8 字节
+ * 渲染线程每帧只上传一部分 (kUploadBytesPerPoll), 传完的块马上就能画
+ * 画的时候出了视锥 (包围球批量过 CullSpheres) 或者背对观察者
+ * (法线锥整个朝后) 的块整块跳过,
+ * 剩下的相邻块合并, 每个 GPU buffer 一次 glMultiDrawArrays,
+ * 所以帧耗时跟着可见的点数走, 不跟着总点数走
+ *
+ * 点选: 内存里的点传完也留着, 每块的点在块内重排成隐式 k-d 树
+ * (区间的中位数是节点, 两半是子树), 不影响画, 块的包围球就是上一层,
+ * 合起来是两层的 BVH, 几千万个点里找最近的一个也只要几十微秒
+ */
+class PointLayer {
+ public:
+  PointLayer();
+  ~PointLayer();
+
+  // 编译 shader 并启动工作线程, 需要在 GL context 创建之后调用
+  // tint 为这一层点的颜色, value 越大越亮
+  bool Load(const std::string& path, const glm::vec4& tint);
+
+  // 每帧在渲染线程调用一次, 把整理好的点分批传进显存, 从不阻塞
+  void Poll();
+
+  // model 为地球的模型矩阵, 点画在单位球上; 只支持正交投影
+  void Draw(const glm::mat4& model, const glm::mat4& view,
+            const glm::mat4& projection);
+
+  // 单位球上 (模型空间) 离 p 最近的点, 远于 max_distance 的不算
+  // 点还没整理好或者范围内没有点时返回 false; 和 Poll/Draw 在同一个线程调用
+  bool Pick(const glm::vec3& p, float max_distance, PointPick* pick) const;
+
+  // 释放显存和线程, 需要在 GL context 还有效时调用
+  void Release();
+
+  // 没有还在进行中的载入和上传
+  bool settled() const { return state_ == kIdle || state_ == kReady ||
+                                state_ == kFailed; }
+  size_t size() const { return total_points_; }
+  // 上一次 Draw 画了多少点
+  size_t visible_points() const { return visible_points_; }
+
+ private:
+  PointLayer(const PointLayer&) = delete;
+  PointLayer& operator=(const PointLayer&) = delete;
+
+  enum State {
+    kIdle,
+    kBuilding,   // 工作线程读文件, 转换, 排序
+    kUploading,  // 渲染线程分批上传
+    kReady,
+    kFailed,
+  };
+
+  // 显存里的一个点, xyz 为单位球上的位置, w 为归一化的 value
+  struct PointVertex {
+    GLshort position[4];
+  };
+
+  // 一块空间上相邻的点
+  struct Chunk {
+    size_t first;  // 在所属 buffer 里的下标
+    GLsizei count;
+    int buffer;
+    glm::vec3 axis;  // 法线锥的轴, 所有点的法线与它的夹角不超过 θ
+    float sin_angle;  // sin θ
+  };
+
+  // 一个 GPU buffer, 装若干个连续的块
+  struct Buffer {
+    GLuint vao;
+    GLuint vbo;
+    size_t first;  // 在 points_ 里的下标
+    size_t count;
+    size_t uploaded;
+  };
+
+  void Build();
+  bool BuildChunks();
+  bool BuildKdTrees();
+  // 把 [first, first + n) 排成隐式 k-d 树, 轮流按 axis / other 两个轴切
+  static void BuildKdTree(PointVertex* first, size_t n, int axis, int other);
+  // 在 k-d 树里找离 q (量化单位) 更近的点
+  static void SearchKdTree(const PointVertex* first, size_t n, int axis,
+                           int other, const glm::vec3& q, float* best_d2,
+                           const PointVertex** best);
+  void DrawRanges(const Buffer& buffer);
+  void ClearBounds();
+  void Join();
+
+  std::string path_;
+  glm::vec4 tint_;
+  GLuint program_;
+  std::atomic<int> state_;
+  std::atomic<bool> cancel_;
+  std::thread worker_;
+  std::chrono::steady_clock::time_point start_;
+
+  // 工作线程写, kUploading 之后渲染线程只读; 传完也留着给 Pick
+  std::vector<PointVertex> points_;
+  std::vector<Chunk> chunks_;
+  // 每块的包围球, 结构数组, 交给 CullSpheres 批量剔除
+  std::vector<float> bound_x_;
+  std::vector<float> bound_y_;
+  std::vector<float> bound_z_;
+  std::vector<float> bound_radius_;
+  std::vector<Buffer> buffers_;
+  size_t total_points_;
+  // value 归一化之前的范围, 没有 value 时 has_values_ 为 false
+  float value_low_;
+  float value_high_;
+  bool has_values_;
+
+  // Draw 里合并可见块用的, 留着避免每帧分配
+  std::vector<uint32_t> visible_;
+  std::vector<GLint> firsts_;
+  std::vector<GLsizei> counts_;
+  size_t visible_points_;
+};
+
+#endif  // GL_EARTH_POINT_LAYER_H_
@@ -0,0 +1,65 @@
+#include "scene_graph.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+SceneGraph::NodeId SceneGraph::AddNode(NodeId parent,
+                                       const glm::vec3& translation,
+                                       const glm::quat& rotation,
+                                       const glm::vec3& scale) {
+  parent_.push_back(parent);
+  translation_.push_back(translation);
+  rotation_.push_back(rotation);
+  scale_.push_back(scale);
+  dirty_.push_back(1);
+  changed_.push_back(0);
+  world_.push_back(glm::mat4(1.f));
+  return static_cast<NodeId>(world_.size() - 1);
+}
+
+void SceneGraph::SetTranslation(NodeId node, const glm::vec3& translation) {
+  if (translation_[node] != translation) {
+    translation_[node] = translation;
+    dirty_[node] = 1;
+  }
+}
+
+void SceneGraph::SetRotation(NodeId node, const glm::quat& rotation) {
+  if (rotation_[node] != rotation) {
+    rotation_[node] = rotation;
+    dirty_[node] = 1;
+  }
+}
+
+void SceneGraph::SetScale(NodeId node, const glm::vec3& scale) {
+  if (scale_[node] != scale) {
+    scale_[node] = scale;
+    dirty_[node] = 1;
+  }
+}
+
+void SceneGraph::Update() {
+  changed_begin_ = world_.size();
+  changed_end_ = 0;
+  for (size_t i = 0; i < world_.size(); i++) {
+    NodeId p = parent_[i];
+    // 父节点在前面, 它这一轮变没变已经知道了
+    bool dirty = dirty_[i] || (p != kNoParent && changed_[p]);
+    changed_[i] = dirty;
+    if (!dirty) {
+      continue;
+    }
+    // local = T * R * S
+    glm::mat4 local = glm::translate(glm::mat4(1.f), translation_[i]) *
+                      glm::mat4_cast(rotation_[i]) *
+                      glm::scale(glm::mat4(1.f), scale_[i]);
+    world_[i] = p == kNoParent ? local : world_[p] * local;
+    dirty_[i] = 0;
+    if (changed_begin_ > i) {
+      changed_begin_ = i;
+    }
+    changed_end_ = i + 1;
+  }
+  if (changed_end_ == 0) {
+    changed_begin_ = 0;
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef GL_EARTH_SCENE_GRAPH_H_
+#define GL_EARTH_SCENE_GRAPH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/**
+ * 场景图
+ * 每个节点有自己的局部变换 (平移, 旋转, 缩放), 一个 dirty 标记,
+ * 和缓存下来的世界矩阵
+ * 以前每帧都用 glLoadIdentity/glRotatef 从头算一遍, 连不动的太阳也算
+ * 现在只有变过的节点和它们的子树才重算
+ *
+ * 节点只能挂在已有的节点下面, 所以父节点的下标一定小于子节点,
+ * Update 按下标顺序扫一遍就行, 不用递归
+ * 世界矩阵连续存放, 渲染时可以整块上传
+ */
+class SceneGraph {
+ public:
+  typedef int NodeId;
+  static const NodeId kNoParent = -1;
+
+  SceneGraph() : changed_begin_(0), changed_end_(0) {}
+
+  // 加一个节点, parent 为 kNoParent 时是根节点
+  NodeId AddNode(NodeId parent,
+                 const glm::vec3& translation = glm::vec3(0.f),
+                 const glm::quat& rotation = glm::quat(),
+                 const glm::vec3& scale = glm::vec3(1.f));
+
+  // 修改局部变换, 值没变就不标脏
+  void SetTranslation(NodeId node, const glm::vec3& translation);
+  void SetRotation(NodeId node, const glm::quat& rotation);
+  void SetScale(NodeId node, const glm::vec3& scale);
+
+  // 重算变过的节点和它们子树的世界矩阵
+  void Update();
+
+  const glm::mat4& world(NodeId node) const { return world_[node]; }
+  NodeId parent(NodeId node) const { return parent_[node]; }
+  size_t size() const { return world_.size(); }
+
+  // 所有世界矩阵, 按节点下标连续存放
+  const glm::mat4* world_matrices() const { return world_.data(); }
+  // 上一次 Update 重算了的节点下标范围 [begin, end), 用于部分上传
+  size_t changed_begin() const { return changed_begin_; }
+  size_t changed_end() const { return changed_end_; }
+  bool changed(NodeId node) const { return changed_[node] != 0; }
+
+ private:
+  std::vector<NodeId> parent_;
+  std::vector<glm::vec3> translation_;
+  std::vector<glm::quat> rotation_;
+  std::vector<glm::vec3> scale_;
+  std::vector<uint8_t> dirty_;    // 局部变换改过了
+  std::vector<uint8_t> changed_;  // 上一次 Update 重算了世界矩阵
+  std::vector<glm::mat4> world_;
+  size_t changed_begin_;
+  size_t changed_end_;
+};
+
+#endif  // GL_EARTH_SCENE_GRAPH_H_
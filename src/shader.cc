@@ -0,0 +1,96 @@
+#include "shader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <glm/gtc/type_ptr.hpp>
+
+namespace {
+
+GLuint CompileShader(const char* name, GLenum type, const char* source) {
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, NULL);
+  glCompileShader(shader);
+
+  GLint ok = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    GLint length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    // 驱动可能报 0, 至少留一个 '\0'
+    std::vector<char> log(std::max(length, 1));
+    glGetShaderInfoLog(shader, log.size(), NULL, log.data());
+    fprintf(stderr, "[%s] %s shader compile failed: %s\n", name,
+            type == GL_VERTEX_SHADER ? "vertex" : "fragment", log.data());
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+}  // namespace
+
+GLuint CompileProgram(const char* name, const char* vertex_source,
+                      const char* fragment_source) {
+  GLuint vs = CompileShader(name, GL_VERTEX_SHADER, vertex_source);
+  GLuint fs = CompileShader(name, GL_FRAGMENT_SHADER, fragment_source);
+  if (!vs || !fs) {
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  // 链接之后 shader 对象就没用了
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+
+  GLint ok = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &ok);
+  if (!ok) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log(std::max(length, 1));
+    glGetProgramInfoLog(program, log.size(), NULL, log.data());
+    fprintf(stderr, "[%s] program link failed: %s\n", name, log.data());
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  GLuint block = glGetUniformBlockIndex(program, "Matrices");
+  if (block != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program, block, MatrixBlock::kBinding);
+  }
+  return program;
+}
+
+void MatrixBlock::Init() {
+  Release();
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, kBinding, buffer_);
+}
+
+void MatrixBlock::Upload(const glm::mat4& projection, const glm::mat4& view) {
+  // std140 下 mat4 就是 4 个 vec4, 和 glm 的内存布局一样 (列主序)
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
+                  glm::value_ptr(projection));
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
+                  glm::value_ptr(view));
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void MatrixBlock::Release() {
+  if (buffer_) {
+    glDeleteBuffers(1, &buffer_);
+  }
+  buffer_ = 0;
+}
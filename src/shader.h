@@ -0,0 +1,50 @@
+#ifndef GL_EARTH_SHADER_H_
+#define GL_EARTH_SHADER_H_
+
+#include <glm/glm.hpp>
+
+#include "opengl.h"
+
+// 所有 shader 的开头, core profile 3.3
+#define GL_EARTH_GLSL_VERSION "#version 330 core\n"
+
+// 所有 shader 共用的矩阵, 放在一个 uniform buffer 里, 每帧上传一次
+// vertex shader 里用这段声明, 每个物体自己的 model 矩阵另外用 uniform 给
+#define GL_EARTH_MATRIX_BLOCK            \
+  "layout(std140) uniform Matrices {\n" \
+  "  mat4 projection;\n"                \
+  "  mat4 view;\n"                      \
+  "};\n"
+
+// 编译并链接一个 GLSL 程序
+// 出错时把 log 打到 stderr, 返回 0
+// name 只用于打印
+// 程序里如果声明了 Matrices, 会自动绑到 MatrixBlock 的 binding point 上
+GLuint CompileProgram(const char* name, const char* vertex_source,
+                      const char* fragment_source);
+
+/**
+ * Matrices 对应的 uniform buffer object
+ * 投影和观察矩阵在 CPU 上用 glm 算好, 每帧 Upload 一次,
+ * 所有程序共用, 不再一个程序一个程序地设 uniform
+ */
+class MatrixBlock {
+ public:
+  static const GLuint kBinding = 0;
+
+  MatrixBlock() : buffer_(0) {}
+  ~MatrixBlock() { Release(); }
+
+  // 需要在 GL context 创建之后调用
+  void Init();
+  void Upload(const glm::mat4& projection, const glm::mat4& view);
+  void Release();
+
+ private:
+  MatrixBlock(const MatrixBlock&) = delete;
+  MatrixBlock& operator=(const MatrixBlock&) = delete;
+
+  GLuint buffer_;
+};
+
+#endif  // GL_EARTH_SHADER_H_
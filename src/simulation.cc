@@ -0,0 +1,162 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+// 落后太多时最多补这么多个 tick, 不然会越补越慢
+const int kMaxCatchUpTicks = 8;
+
+}  // namespace
+
+Simulation::Simulation() : running_(false), paused_(false) {
+  state_.tick = 0;
+  state_.time = 0;
+  state_.angle = 0;
+  state_.speed = 1;
+  state_.earth_size = 0.3;
+  SimSnapshot snapshot = {state_, state_};
+  snapshots_.back() = snapshot;
+  snapshots_.Publish();
+  start_ = Clock::now().time_since_epoch().count();
+}
+
+void Simulation::Start(double tick_interval) {
+  Stop();
+  Clock::time_point start =
+      Clock::now() - std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(state_.time));
+  start_ = start.time_since_epoch().count();
+  running_ = true;
+  paused_ = false;
+  worker_ = std::thread(&Simulation::Run, this, tick_interval);
+}
+
+void Simulation::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cond_.notify_one();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void Simulation::Pause() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!paused_) {
+    paused_ = true;
+    paused_at_ = Clock::now();
+  }
+}
+
+void Simulation::Resume() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!paused_) {
+      return;
+    }
+    paused_ = false;
+    // 模拟时钟跳过停住的这段时间, 和 state_.time 继续对得上
+    ShiftStart(Clock::now() - paused_at_);
+  }
+  cond_.notify_one();
+}
+
+void Simulation::Run(double tick_interval) {
+  Clock::duration interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(tick_interval));
+  while (running_) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (paused_) {
+        // Resume 已经把时钟零点挪过了, 下面照常从零点排
+        cond_.wait(lock, [this] { return !paused_ || !running_; });
+        continue;
+      }
+    }
+    // 第 n 个 tick 在零点之后 n 个间隔, 每次都从零点算, 不会越排越偏
+    Clock::time_point next = start() + interval * (state_.tick + 1);
+    std::this_thread::sleep_until(next);
+    int ticks = 0;
+    while (Clock::now() >= next && ticks < kMaxCatchUpTicks) {
+      Tick(tick_interval);
+      next += interval;
+      ticks++;
+    }
+    // 实在追不上了, 就丢掉整数个 tick, 时钟零点一起往后挪,
+    // 这样 Now() 和 state_.time 还是对得上, 插值不会一直卡在最新的 tick
+    Clock::time_point now = Clock::now();
+    if (now >= next) {
+      ShiftStart(interval * ((now - next) / interval + 1));
+    }
+  }
+}
+
+void Simulation::Step(double dt) { Tick(dt); }
+
+void Simulation::Tick(double dt) {
+  SimState previous = state_;
+
+  SimCommand command;
+  while (commands_.Pop(&command)) {
+    switch (command.type) {
+      case SimCommand::kSpeedUp:
+        state_.speed++;
+        printf("[SpeedUp] current speed: %d\n", state_.speed);
+        break;
+      case SimCommand::kSlowDown:
+        state_.speed--;
+        printf("[SlowDown] current speed: %d\n", state_.speed);
+        break;
+      case SimCommand::kEarthSizeUp:
+        state_.earth_size += 0.01;
+        printf("[EarthSizeUp] current size: %.3f\n", state_.earth_size);
+        break;
+      case SimCommand::kEarthSizeDown:
+        state_.earth_size -= 0.01;
+        printf("[EarthSizeDown] current size: %.3f\n", state_.earth_size);
+        break;
+    }
+    fflush(stdout);
+  }
+
+  state_.tick++;
+  state_.time += dt;
+  state_.angle += dt * 50.0 * state_.speed;
+
+  SimSnapshot& snapshot = snapshots_.back();
+  snapshot.previous = previous;
+  snapshot.current = state_;
+  snapshots_.Publish();
+}
+
+bool Simulation::Post(SimCommand::Type type) {
+  SimCommand command = {type};
+  return commands_.Push(command);
+}
+
+SimState Simulation::Sample(double now) {
+  const SimSnapshot& snapshot = snapshots_.Read();
+  const SimState& a = snapshot.previous;
+  const SimState& b = snapshot.current;
+  double span = b.time - a.time;
+  if (span <= 0) {
+    return b;
+  }
+  // 晚一个 tick 画, 这样 now 总是落在 a 和 b 之间
+  double alpha = std::min(std::max((now - span - a.time) / span, 0.0), 1.0);
+  SimState state = b;
+  state.time = a.time + (b.time - a.time) * alpha;
+  state.angle = a.angle + (b.angle - a.angle) * alpha;
+  state.earth_size = a.earth_size + (b.earth_size - a.earth_size) * alpha;
+  return state;
+}
+
+SimState Simulation::Latest() { return snapshots_.Read().current; }
+
+double Simulation::Now() const {
+  return std::chrono::duration<double>(Clock::now() - start()).count();
+}
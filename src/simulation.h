@@ -0,0 +1,143 @@
+#ifndef GL_EARTH_SIMULATION_H_
+#define GL_EARTH_SIMULATION_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "input_queue.h"
+
+/**
+ * 无锁三缓冲
+ * 写者总有一块自己的缓冲可写, 读者总能拿到最新发布的一块,
+ * 双方都不用等对方; 中间那块通过一次原子交换在两边之间传递
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : middle_(1), back_(2), front_(0) {}
+
+  // 写者: 在 back() 上写好之后 Publish
+  T& back() { return buffers_[back_]; }
+  void Publish() {
+    back_ = middle_.exchange(back_ | kDirty, std::memory_order_acq_rel) &
+            kIndexMask;
+  }
+
+  // 读者: 有新发布的就换过来, 返回最新的一块
+  const T& Read() {
+    if (middle_.load(std::memory_order_relaxed) & kDirty) {
+      front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    }
+    return buffers_[front_];
+  }
+
+ private:
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  static const uint8_t kIndexMask = 3;
+  static const uint8_t kDirty = 4;
+
+  T buffers_[3];
+  std::atomic<uint8_t> middle_;
+  uint8_t back_;   // 只有写者用
+  uint8_t front_;  // 只有读者用
+};
+
+// 模拟的状态, 以前散落在 GLContext 里
+struct SimState {
+  uint64_t tick;
+  double time;        // 模拟时间 (秒)
+  double angle;       // 视角旋转的角度 (度), 每秒转 50 * speed 度
+  int speed;
+  double earth_size;
+};
+
+// 发布给渲染线程的快照: 最近两个 tick 的状态, 渲染时在二者之间插值
+struct SimSnapshot {
+  SimState previous;
+  SimState current;
+};
+
+// 发给模拟线程的命令
+struct SimCommand {
+  enum Type : uint8_t {
+    kSpeedUp,
+    kSlowDown,
+    kEarthSizeUp,
+    kEarthSizeDown,
+  };
+  Type type;
+};
+
+/**
+ * 模拟
+ * 在自己的线程里以固定的频率 tick, 每个 tick 处理命令, 推进状态,
+ * 再通过三缓冲把快照发布给渲染线程
+ * 渲染线程晚一个 tick, 在最近两个 tick 之间插值, 所以画面是平滑的,
+ * 而模拟和渲染各跑各的, 谁也不占谁的时间
+ * 画面静止或窗口隐藏时可以 Pause, 模拟线程睡在条件变量上, 模拟时钟也停住
+ */
+class Simulation {
+ public:
+  Simulation();
+  ~Simulation() { Stop(); }
+
+  // 启动模拟线程, 每 tick_interval 秒一个 tick
+  void Start(double tick_interval);
+  void Stop();
+
+  // 暂停/恢复模拟线程, 只能由主线程调用; 重复调用没有影响
+  // 暂停的这段时间不算进模拟时钟, 恢复后从停下的地方接着走
+  void Pause();
+  void Resume();
+
+  // 不启线程, 在调用者的线程里同步推进一个 tick (基准测试用)
+  void Step(double dt);
+
+  // 发命令, 只能由一个线程调用 (主线程)
+  bool Post(SimCommand::Type type);
+
+  // 渲染线程: 取 now 时刻 (模拟时钟) 要画的状态, 在最近两个 tick 间插值
+  SimState Sample(double now);
+  // 渲染线程: 最新一个 tick 的状态, 不插值
+  SimState Latest();
+
+  // 模拟时钟, Start 之后经过的秒数
+  double Now() const;
+
+ private:
+  Simulation(const Simulation&) = delete;
+  Simulation& operator=(const Simulation&) = delete;
+
+  typedef std::chrono::steady_clock Clock;
+
+  void Run(double tick_interval);
+
+  // 模拟时钟的零点; 模拟线程丢 tick 和主线程 Resume 时都会往后挪
+  Clock::time_point start() const {
+    return Clock::time_point(Clock::duration(start_.load()));
+  }
+  void ShiftStart(Clock::duration by) { start_ += by.count(); }
+  void Tick(double dt);
+
+  SimState state_;  // 只有模拟线程 (或 Step 的调用者) 读写
+  TripleBuffer<SimSnapshot> snapshots_;
+  SpscRing<SimCommand, 64> commands_;
+
+  std::atomic<Clock::rep> start_;  // Clock 的 time_since_epoch
+  std::atomic<bool> running_;
+  std::thread worker_;
+
+  // 暂停时模拟线程等在 cond_ 上
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool paused_;
+  Clock::time_point paused_at_;
+};
+
+#endif  // GL_EARTH_SIMULATION_H_
@@ -0,0 +1,40 @@
+#include "sphere.h"
+
+#include <cmath>
+
+void BuildUvSphere(int stacks, int slices, std::vector<Vertex>* vertices,
+                   std::vector<GLuint>* indices) {
+  vertices->clear();
+  indices->clear();
+  vertices->reserve((stacks + 1) * (slices + 1));
+  indices->reserve(stacks * slices * 6);
+
+  // 经度方向多放一列顶点, 让 u = 0 和 u = 1 的接缝各自有贴图坐标
+  for (int i = 0; i <= stacks; i++) {
+    float v = static_cast<float>(i) / stacks;
+    float phi = v * M_PI;  // 0 为北极
+    for (int j = 0; j <= slices; j++) {
+      float u = static_cast<float>(j) / slices;
+      float lon = u * 2.f * M_PI - M_PI;
+      Vertex vertex = {{std::sin(phi) * std::sin(lon), std::cos(phi),
+                        std::sin(phi) * std::cos(lon)},
+                       {u, v},
+                       {1.f, 1.f, 1.f, 1.f}};
+      vertices->push_back(vertex);
+    }
+  }
+
+  // 从外面看是逆时针 (CCW), 这样可以用 GL_CULL_FACE 剔除背面
+  for (int i = 0; i < stacks; i++) {
+    for (int j = 0; j < slices; j++) {
+      GLuint a = i * (slices + 1) + j;
+      GLuint b = a + slices + 1;
+      indices->push_back(a);
+      indices->push_back(b);
+      indices->push_back(b + 1);
+      indices->push_back(a);
+      indices->push_back(b + 1);
+      indices->push_back(a + 1);
+    }
+  }
+}
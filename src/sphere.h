@@ -0,0 +1,15 @@
+#ifndef GL_EARTH_SPHERE_H_
+#define GL_EARTH_SPHERE_H_
+
+#include <vector>
+
+#include "mesh.h"
+
+// 单位 UV 球
+// 极轴为 y, 经度 0 朝向 +z (屏幕外)
+// 贴图按等距圆柱投影 (equirectangular) 映射:
+// u 从经度 -180 到 180, v = 0 为北极, 对应图片第一行
+void BuildUvSphere(int stacks, int slices, std::vector<Vertex>* vertices,
+                   std::vector<GLuint>* indices);
+
+#endif  // GL_EARTH_SPHERE_H_
@@ -0,0 +1,95 @@
+#include "sun.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "shader.h"
+
+namespace {
+
+// 有日冕时正方形的半边长 (以太阳半径为单位), 日冕在这个范围内衰减到 0
+const float kCoronaExtent = 1.6f;
+// 没有日冕时只给边缘的抗锯齿留一点余量
+const float kDiskExtent = 1.05f;
+
+// uv 为正方形内的坐标, 单位圆就是太阳
+// 渐变和以前的扇形一样: 顶点颜色先截到 [0, 1], 再沿半径线性插值
+// 结果是预乘了 alpha 的, 配合 glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+const char kFragmentShader[] =
+    GL_EARTH_GLSL_VERSION
+    "uniform vec4 center_color;\n"
+    "uniform vec4 edge_color;\n"
+    "uniform float corona;\n"
+    "uniform float extent;\n"
+    "in vec2 uv;\n"
+    "in vec4 tint;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "  float d = length(uv);\n"
+    "  float aa = fwidth(d);\n"
+    "  float disk = 1.0 - smoothstep(1.0 - aa, 1.0 + aa, d);\n"
+    "  vec3 color = mix(clamp(center_color.rgb, 0.0, 1.0),\n"
+    "                   clamp(edge_color.rgb, 0.0, 1.0), min(d, 1.0));\n"
+    "  float fade = 1.0 - smoothstep(1.0, extent, d);\n"
+    "  float glow = corona * fade * fade * (1.0 - disk);\n"
+    "  frag_color = vec4(color * disk + edge_color.rgb * glow, disk + glow);\n"
+    "}\n";
+
+}  // namespace
+
+bool Sun::Init(const GLfloat center_color[4], const GLfloat edge_color[4],
+               float corona) {
+  Release();
+  program_ = CompileProgram("sun", kMeshVertexShader, kFragmentShader);
+  if (!program_) {
+    return false;
+  }
+  corona_ = std::max(corona, 0.f);
+  float extent = corona_ > 0.f ? kCoronaExtent : kDiskExtent;
+
+  glUseProgram(program_);
+  glUniform4fv(glGetUniformLocation(program_, "center_color"), 1,
+               center_color);
+  glUniform4fv(glGetUniformLocation(program_, "edge_color"), 1, edge_color);
+  glUniform1f(glGetUniformLocation(program_, "corona"), corona_);
+  glUniform1f(glGetUniformLocation(program_, "extent"), extent);
+  glUseProgram(0);
+
+  // 贴图坐标就是模型空间的坐标, fragment shader 用它算到圆心的距离
+  std::vector<Vertex> vertices;
+  const float corners[4][2] = {{-1.f, -1.f}, {1.f, -1.f}, {1.f, 1.f},
+                               {-1.f, 1.f}};
+  for (int i = 0; i < 4; i++) {
+    float x = corners[i][0] * extent;
+    float y = corners[i][1] * extent;
+    Vertex v = {{x, y, 0.f}, {x, y}, {1.f, 1.f, 1.f, 1.f}};
+    vertices.push_back(v);
+  }
+  std::vector<GLuint> indices = {0, 1, 2, 0, 2, 3};
+  quad_.Upload(GL_TRIANGLES, vertices, indices);
+  return true;
+}
+
+void Sun::Draw(const glm::mat4& model) const {
+  if (!program_) {
+    return;
+  }
+  glUseProgram(program_);
+  glUniformMatrix4fv(glGetUniformLocation(program_, "model"), 1, GL_FALSE,
+                     glm::value_ptr(model));
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  quad_.Draw();
+  glDisable(GL_BLEND);
+  glUseProgram(0);
+}
+
+void Sun::Release() {
+  quad_.Release();
+  if (program_) {
+    glDeleteProgram(program_);
+  }
+  program_ = 0;
+}
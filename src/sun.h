@@ -0,0 +1,40 @@
+#ifndef GL_EARTH_SUN_H_
+#define GL_EARTH_SUN_H_
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+
+/**
+ * 太阳
+ * 以前是 10000 个三角形的扇形, 每帧 10002 个顶点就为了画一个圆
+ * 现在是一个正方形, 圆和渐变都在 fragment shader 里按到圆心的距离算,
+ * 边缘按屏幕上的像素宽度做抗锯齿, 放多大都是圆的
+ * 还可以在圆盘外面加一圈日冕 (corona)
+ */
+class Sun {
+ public:
+  Sun() : program_(0), corona_(0.f) {}
+  ~Sun() { Release(); }
+
+  // 需要在 GL context 创建之后调用
+  // center_color 为圆心的颜色, edge_color 为圆边的颜色, 中间线性渐变
+  // corona 为日冕的亮度, 0 为不要
+  bool Init(const GLfloat center_color[4], const GLfloat edge_color[4],
+            float corona);
+
+  // model 把单位圆放到目标位置和半径
+  void Draw(const glm::mat4& model) const;
+
+  void Release();
+
+ private:
+  Sun(const Sun&) = delete;
+  Sun& operator=(const Sun&) = delete;
+
+  Mesh quad_;
+  GLuint program_;
+  float corona_;
+};
+
+#endif  // GL_EARTH_SUN_H_
@@ -0,0 +1,111 @@
+// earth_texc: 贴图的离线压缩
+// 把 png/jpg 解码, 生成 mipmap 链, 每一级压成 BC1/BC3/BC7 块, 写成 DDS
+// 放在源图旁边 (xxx.png.dds), earth 载入 xxx.png 时会优先用它
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "block_compress.h"
+#include "dds.h"
+#include "image.h"
+#include "mipmap.h"
+
+namespace {
+
+void PrintHelper() {
+  printf("Usage: earth_texc [options] image...\n");
+  printf("  --format bc1|bc3|bc7: block format, default bc1\n");
+  printf("    bc1: RGB, 4 bits/texel, 8x smaller than RGBA8\n");
+  printf("    bc3: RGBA, 8 bits/texel\n");
+  printf("    bc7: RGBA, 8 bits/texel, best quality, needs GL 4.2 / BPTC\n");
+  printf("  --threads N: encoder threads, default all cores\n");
+  printf("Writes image.dds next to each image\n");
+}
+
+// 压一张图, 成功返回 true
+bool CompressFile(const std::string& path, BlockFormat format, int threads) {
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+
+  std::vector<unsigned char> rgba;
+  int width;
+  int height;
+  if (!DecodeImage(path, threads, &rgba, &width, &height)) {
+    return false;
+  }
+  std::vector<unsigned char> chain;
+  std::vector<MipLevel> levels;
+  BuildMipChain(rgba.data(), width, height, threads, &chain, &levels);
+
+  // 每一级各自压缩, 接在一起
+  std::vector<unsigned char> data;
+  std::vector<MipLevel> blocks;
+  std::vector<unsigned char> level_data;
+  for (const MipLevel& level : levels) {
+    CompressImage(format, chain.data() + level.offset, level.width,
+                  level.height, threads, &level_data);
+    MipLevel block_level = {level.width, level.height, data.size(),
+                            level_data.size()};
+    blocks.push_back(block_level);
+    data.insert(data.end(), level_data.begin(), level_data.end());
+  }
+
+  std::string out = DdsPathFor(path);
+  if (!WriteDds(out, format, blocks, data)) {
+    fprintf(stderr, "write %s failed %s:%d\n", out.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%s: %dx%d %d levels, %s %.1f MB -> %.1f MB (%.1fx), %.2f s\n",
+         out.c_str(), width, height, static_cast<int>(levels.size()),
+         BlockFormatName(format), chain.size() / 1048576.0,
+         data.size() / 1048576.0,
+         static_cast<double>(chain.size()) / data.size(), seconds);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  BlockFormat format = kBC1;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::string> images;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--format" && has_value) {
+      if (!ParseBlockFormat(argv[++i], &format)) {
+        PrintHelper();
+        return -1;
+      }
+    } else if (arg == "--threads" && has_value) {
+      threads = std::max(1, atoi(argv[++i]));
+    } else if (arg.compare(0, 2, "--") == 0) {
+      PrintHelper();
+      return -1;
+    } else {
+      images.push_back(arg);
+    }
+  }
+  if (images.empty()) {
+    PrintHelper();
+    return -1;
+  }
+
+  if (!InitImageDecoder()) {
+    return -1;
+  }
+
+  int failed = 0;
+  for (const std::string& image : images) {
+    if (!CompressFile(image, format, threads)) {
+      failed++;
+    }
+  }
+  return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,195 @@
+#include "texture_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "dds.h"
+
+namespace {
+
+// 格式说明见 https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html
+const unsigned char kKtx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                           0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+// 用到的几个 VkFormat
+const uint32_t kVkRgba8Unorm = 37;
+const uint32_t kVkBc1RgbUnorm = 131;
+const uint32_t kVkBc1RgbaUnorm = 133;
+const uint32_t kVkBc3Unorm = 137;
+const uint32_t kVkBc7Unorm = 145;
+
+const uint32_t kMaxSize = 1 << 16;
+const uint32_t kMaxLevels = 17;
+
+struct Ktx2Header {
+  unsigned char identifier[12];
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+
+struct Ktx2Level {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be 80 bytes");
+
+bool EndsWith(const std::string& s, const char* suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+}  // namespace
+
+bool TextureFile::IsContainer(const std::string& path) {
+  return EndsWith(path, ".ktx2") || EndsWith(path, ".dds");
+}
+
+bool TextureFile::Open(const std::string& path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // mmap 之后 fd 就可以关了
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  map_ = map;
+  map_size_ = size;
+
+  const unsigned char* file = static_cast<const unsigned char*>(map);
+  bool ok;
+  if (size >= sizeof(kKtx2Identifier) &&
+      memcmp(file, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0) {
+    ok = ParseKtx2(file, size);
+  } else {
+    size_t offset = 0;
+    ok = ParseDds(file, size, &compressed_, &format_, &levels_, &offset);
+    data_ = file + offset;
+  }
+  if (!ok) {
+    fprintf(stderr, "%s: unsupported texture file %s:%d\n", path.c_str(),
+            __FILE__, __LINE__);
+    Close();
+    return false;
+  }
+  return true;
+}
+
+// KTX2 每一级的偏移量是相对于文件开头的, data_ 就是文件开头
+// 只认没有超压缩 (Basis/zstd) 的单张 2D 贴图
+bool TextureFile::ParseKtx2(const unsigned char* file, size_t size) {
+  Ktx2Header header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, file, sizeof(header));
+  if (header.pixel_width == 0 || header.pixel_height == 0 ||
+      header.pixel_width > kMaxSize || header.pixel_height > kMaxSize ||
+      header.pixel_depth > 1 || header.layer_count > 1 ||
+      header.face_count != 1 || header.supercompression_scheme != 0) {
+    return false;
+  }
+
+  compressed_ = true;
+  switch (header.vk_format) {
+    case kVkRgba8Unorm:
+      compressed_ = false;
+      break;
+    case kVkBc1RgbUnorm:
+    case kVkBc1RgbaUnorm:
+      format_ = kBC1;
+      break;
+    case kVkBc3Unorm:
+      format_ = kBC3;
+      break;
+    case kVkBc7Unorm:
+      format_ = kBC7;
+      break;
+    default:
+      return false;
+  }
+
+  // level_count 为 0 表示让使用者自己生成 mipmap, 文件里只有第 0 级
+  uint32_t count = std::max<uint32_t>(header.level_count, 1);
+  if (count > kMaxLevels ||
+      sizeof(header) + count * sizeof(Ktx2Level) > size) {
+    return false;
+  }
+  int w = static_cast<int>(header.pixel_width);
+  int h = static_cast<int>(header.pixel_height);
+  for (uint32_t i = 0; i < count; i++) {
+    Ktx2Level entry;
+    memcpy(&entry, file + sizeof(header) + i * sizeof(Ktx2Level),
+           sizeof(entry));
+    size_t expected = compressed_ ? CompressedSize(format_, w, h)
+                                  : static_cast<size_t>(w) * h * 4;
+    if (entry.byte_length != expected || entry.byte_offset > size ||
+        entry.byte_length > size - entry.byte_offset) {
+      levels_.clear();
+      return false;
+    }
+    MipLevel level = {w, h, static_cast<size_t>(entry.byte_offset), expected};
+    levels_.push_back(level);
+    w = std::max(1, w / 2);
+    h = std::max(1, h / 2);
+  }
+  data_ = file;
+  return true;
+}
+
+void TextureFile::Close() {
+  if (map_) {
+    munmap(map_, map_size_);
+  }
+  map_ = NULL;
+  map_size_ = 0;
+  data_ = NULL;
+  levels_.clear();
+}
+
+void TextureFile::Prefault() const {
+  if (!map_) {
+    return;
+  }
+  madvise(map_, map_size_, MADV_WILLNEED);
+  // madvise 只是建议, 每页摸一下才能保证都在内存里
+  long page = sysconf(_SC_PAGESIZE);
+  const volatile unsigned char* p =
+      static_cast<const volatile unsigned char*>(map_);
+  unsigned char sum = 0;
+  for (size_t i = 0; i < map_size_; i += page) {
+    sum += p[i];
+  }
+  (void)sum;
+}
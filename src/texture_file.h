@@ -0,0 +1,60 @@
+#ifndef GL_EARTH_TEXTURE_FILE_H_
+#define GL_EARTH_TEXTURE_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "block_compress.h"
+#include "mipmap.h"
+
+/**
+ * GPU 直接能用的贴图文件 (KTX2 或 DDS)
+ * 整个文件 mmap 进来, 只解析文件头, 像素原样留在 mmap 里,
+ * 上传时把 data() + level.offset 直接交给 glTexImage2D/glCompressedTexImage2D,
+ * 中间不经过 SDL_Surface, 也没有任何拷贝
+ * 支持 BC1/BC3/BC7 和未压缩的 RGBA8, 带不带 mipmap 都行
+ */
+class TextureFile {
+ public:
+  TextureFile()
+      : map_(NULL),
+        map_size_(0),
+        data_(NULL),
+        compressed_(false),
+        format_(kBC1) {}
+  ~TextureFile() { Close(); }
+
+  // 按扩展名判断是不是 .ktx2/.dds
+  static bool IsContainer(const std::string& path);
+
+  // 打开并解析, 格式不认识或者文件不完整时返回 false
+  bool Open(const std::string& path);
+  void Close();
+
+  // 预先把所有页读进内存 (在工作线程调用),
+  // 免得上传时渲染线程卡在缺页上
+  void Prefault() const;
+
+  bool is_open() const { return map_ != NULL; }
+  const std::vector<MipLevel>& levels() const { return levels_; }
+  // levels 的 offset 相对于它
+  const unsigned char* data() const { return data_; }
+  bool compressed() const { return compressed_; }
+  BlockFormat format() const { return format_; }
+
+ private:
+  TextureFile(const TextureFile&) = delete;
+  TextureFile& operator=(const TextureFile&) = delete;
+
+  bool ParseKtx2(const unsigned char* file, size_t size);
+
+  void* map_;
+  size_t map_size_;
+  const unsigned char* data_;
+  std::vector<MipLevel> levels_;
+  bool compressed_;
+  BlockFormat format_;
+};
+
+#endif  // GL_EARTH_TEXTURE_FILE_H_
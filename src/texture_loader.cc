@@ -0,0 +1,300 @@
+#include "texture_loader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "dds.h"
+#include "gl_caps.h"
+#include "image.h"
+
+namespace {
+
+// 占位贴图的颜色, 深蓝, 像一片海
+const GLubyte kPlaceholderPixel[4] = {26, 51, 102, 255};
+
+// 有的 gl 头文件没有这几个扩展格式
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+GLenum GLFormat(BlockFormat format) {
+  switch (format) {
+    case kBC1:
+      return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case kBC3:
+      return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case kBC7:
+      return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  }
+  return 0;
+}
+
+}  // namespace
+
+AsyncTexture::AsyncTexture()
+    : texture_id_(0),
+      bytes_(0),
+      pbo_(0),
+      state_(kIdle),
+      mapped_(NULL),
+      cancel_(false),
+      chain_data_(NULL),
+      chain_size_(0),
+      compressed_(false),
+      format_(kBC1) {
+  for (int i = 0; i < 3; i++) {
+    format_supported_[i] = false;
+  }
+}
+
+AsyncTexture::~AsyncTexture() { Join(); }
+
+void AsyncTexture::Load(const std::string& path) {
+  Release();
+  path_ = path;
+
+  glGenTextures(1, &texture_id_);
+  glBindTexture(GL_TEXTURE_2D, texture_id_);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+  // 先放个占位的, 第一帧马上就能画
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               kPlaceholderPixel);
+  bytes_ = sizeof(kPlaceholderPixel);
+
+  // S3TC 不在任何版本的核心里, BPTC 从 4.2 起是核心
+  bool s3tc = HasGLExtension("GL_EXT_texture_compression_s3tc");
+  format_supported_[kBC1] = s3tc;
+  format_supported_[kBC3] = s3tc;
+  format_supported_[kBC7] = GLVersionAtLeast(4, 2) ||
+                            HasGLExtension("GL_ARB_texture_compression_bptc");
+
+  cancel_ = false;
+  mapped_ = NULL;
+  compressed_ = false;
+  state_ = kDecoding;
+  worker_ = std::thread(&AsyncTexture::Decode, this);
+}
+
+// 工作线程
+void AsyncTexture::Decode() {
+  // GPU 直接能用的文件不用中转, 渲染线程直接从 mmap 上传
+  if (OpenTextureFile()) {
+    state_ = kFilled;
+    return;
+  }
+  // .ktx2/.dds 打不开就没有别的办法了, SDL_image 也解不了
+  if (TextureFile::IsContainer(path_)) {
+    state_ = kFailed;
+    return;
+  }
+  // 再看缓存, 命中的话整条 mipmap 链就在 mmap 里
+  if (cache_.Open(path_)) {
+    levels_ = cache_.levels();
+    chain_data_ = cache_.data();
+  } else if (DecodeSource()) {
+    chain_data_ = chain_.data();
+  } else {
+    state_ = kFailed;
+    return;
+  }
+  const MipLevel& last = levels_.back();
+  chain_size_ = last.offset + last.size;
+  state_ = kDecoded;
+
+  // 等渲染线程把 PBO map 好
+  void* dst;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return mapped_ != NULL || cancel_; });
+    if (cancel_) {
+      return;
+    }
+    dst = mapped_;
+  }
+
+  memcpy(dst, chain_data_, chain_size_);
+  chain_data_ = NULL;
+  std::vector<unsigned char>().swap(chain_);
+  cache_.Close();
+  state_ = kFilled;
+}
+
+// 解码源图并生成 mipmap 链, 顺便写缓存
+bool AsyncTexture::DecodeSource() {
+  std::vector<unsigned char> base;
+  int width;
+  int height;
+  if (!DecodeImage(path_, std::thread::hardware_concurrency(), &base, &width,
+                   &height)) {
+    return false;
+  }
+  BuildMipChain(base.data(), width, height,
+                std::thread::hardware_concurrency(), &chain_, &levels_);
+  if (!MipCache::Write(path_, chain_, levels_)) {
+    fprintf(stderr, "write mip cache %s failed %s:%d\n",
+            MipCache::PathFor(path_).c_str(), __FILE__, __LINE__);
+  }
+  return true;
+}
+
+// 打开 path_ 本身 (.ktx2/.dds), 或者源图旁边 earth_texc 压好的 DDS
+// 源图比 DDS 新 (压完之后又改过图), 或者驱动不支持它的格式, 就不用
+bool AsyncTexture::OpenTextureFile() {
+  std::string path = path_;
+  if (!TextureFile::IsContainer(path_)) {
+    path = DdsPathFor(path_);
+    uint64_t size;
+    int64_t dds_mtime;
+    int64_t source_mtime;
+    if (!FileStamp(path, &size, &dds_mtime)) {
+      return false;
+    }
+    if (FileStamp(path_, &size, &source_mtime) && source_mtime > dds_mtime) {
+      fprintf(stderr, "%s is older than %s, ignored\n", path.c_str(),
+              path_.c_str());
+      return false;
+    }
+  }
+  if (!file_.Open(path)) {
+    fprintf(stderr, "open %s failed %s:%d\n", path.c_str(), __FILE__,
+            __LINE__);
+    return false;
+  }
+  if (file_.compressed() && !format_supported_[file_.format()]) {
+    fprintf(stderr, "%s: %s not supported by the driver, ignored\n",
+            path.c_str(), BlockFormatName(file_.format()));
+    file_.Close();
+    return false;
+  }
+  // 缺页在这里处理掉, 渲染线程上传时就只剩内存拷贝
+  file_.Prefault();
+  levels_ = file_.levels();
+  compressed_ = file_.compressed();
+  format_ = file_.format();
+  return true;
+}
+
+bool AsyncTexture::Poll() {
+  switch (state_) {
+    case kDecoded: {
+      GLsizeiptr size = static_cast<GLsizeiptr>(chain_size_);
+      glGenBuffers(1, &pbo_);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+      void* ptr = glMapBufferRange(
+          GL_PIXEL_UNPACK_BUFFER, 0, size,
+          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      if (!ptr) {
+        fprintf(stderr, "PBO map failed %s:%d\n", __FILE__, __LINE__);
+        glDeleteBuffers(1, &pbo_);
+        pbo_ = 0;
+        Join();
+        state_ = kFailed;
+        return false;
+      }
+      // 先切到 kFilling 再把地址交出去; 反过来的话 worker 可能先拷完写了
+      // kFilled, 又被这里的 kFilling 盖掉, 永远停在 kFilling
+      state_ = kFilling;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mapped_ = ptr;
+      }
+      cond_.notify_one();
+      return false;
+    }
+    case kFilled: {
+      if (pbo_) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      }
+      glBindTexture(GL_TEXTURE_2D, texture_id_);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      bytes_ = 0;
+      // 绑定了 PBO 时, 最后一个参数是 PBO 内的偏移量
+      // 否则就是 mmap 里的地址, driver 直接从文件映射读
+      for (size_t i = 0; i < levels_.size(); i++) {
+        const MipLevel& level = levels_[i];
+        bytes_ += level.size;
+        const GLvoid* pixels =
+            pbo_ ? reinterpret_cast<const GLvoid*>(level.offset)
+                 : file_.data() + level.offset;
+        if (compressed_) {
+          glCompressedTexImage2D(GL_TEXTURE_2D, i, GLFormat(format_),
+                                 level.width, level.height, 0,
+                                 static_cast<GLsizei>(level.size), pixels);
+        } else {
+          glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, level.width, level.height,
+                       0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      file_.Close();
+      // 整条链都有了才能打开三线性过滤, 否则贴图不完整
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                      static_cast<GLint>(levels_.size()) - 1);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                      GL_LINEAR_MIPMAP_LINEAR);
+      // 可以马上删, driver 会等传输完成再真正释放
+      glDeleteBuffers(1, &pbo_);
+      pbo_ = 0;
+      mapped_ = NULL;
+      Join();
+      state_ = kReady;
+      printf("%s:%d -- %s %d %d (%d levels, %s)\n", __FILE__, __LINE__,
+             path_.c_str(), levels_[0].width, levels_[0].height,
+             static_cast<int>(levels_.size()),
+             compressed_ ? BlockFormatName(format_) : "rgba");
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+void AsyncTexture::Join() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancel_ = true;
+  }
+  cond_.notify_one();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void AsyncTexture::Release() {
+  Join();
+  if (pbo_) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo_);
+    pbo_ = 0;
+  }
+  if (texture_id_) {
+    glDeleteTextures(1, &texture_id_);
+    texture_id_ = 0;
+  }
+  bytes_ = 0;
+  chain_data_ = NULL;
+  std::vector<unsigned char>().swap(chain_);
+  levels_.clear();
+  cache_.Close();
+  file_.Close();
+  mapped_ = NULL;
+  state_ = kIdle;
+}
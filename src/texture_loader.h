@@ -0,0 +1,100 @@
+#ifndef GL_EARTH_TEXTURE_LOADER_H_
+#define GL_EARTH_TEXTURE_LOADER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "block_compress.h"
+#include "mipmap.h"
+#include "opengl.h"
+#include "texture_file.h"
+
+/**
+ * 异步载入的贴图
+ * 图片解码和 mipmap 生成在工作线程里完成, 不卡渲染线程
+ * 有 mipmap 缓存 (见 MipCache) 时直接 mmap 缓存, 不解码也不缩小
+ * path 本身是 .ktx2/.dds, 或者旁边有 earth_texc 压好的 DDS, 并且驱动支持
+ * 它的格式时, 优先用它 (见 TextureFile), 压缩贴图的显存和带宽都只有
+ * RGBA8 的 1/8 ~ 1/4; 这种文件 mmap 之后直接从映射上传, 不走 PBO
+ * 其它情况上传通过 PBO (pixel buffer object) 中转: 渲染线程 map 好 PBO,
+ * 工作线程把整条 mipmap 链拷进去, 渲染线程再从 PBO 逐级 glTexImage2D
+ * 真正的图准备好之前, 先用一个 1x1 的占位贴图
+ */
+class AsyncTexture {
+ public:
+  AsyncTexture();
+  ~AsyncTexture();
+
+  // 创建占位贴图并启动解码线程, 需要在 GL context 创建之后调用
+  void Load(const std::string& path);
+
+  // 每帧在渲染线程调用一次, 推进上传的状态机, 从不阻塞
+  // 返回 true 表示真正的贴图刚刚就绪
+  bool Poll();
+
+  // 释放显存和线程, 需要在 GL context 还有效时调用
+  void Release();
+
+  GLuint texture_id() const { return texture_id_; }
+  // 贴图在显存里占的字节数 (整条 mipmap 链), 没就绪时是占位贴图的
+  size_t bytes() const { return bytes_; }
+  bool ready() const { return state_ == kReady; }
+  // 没有还在进行中的载入 (没开始, 已就绪, 或者失败了)
+  bool settled() const {
+    return state_ == kIdle || state_ == kReady || state_ == kFailed;
+  }
+
+ private:
+  AsyncTexture(const AsyncTexture&) = delete;
+  AsyncTexture& operator=(const AsyncTexture&) = delete;
+
+  enum State {
+    kIdle,      // 还没开始
+    kDecoding,  // 工作线程解码或读缓存中
+    kDecoded,   // mipmap 链已备好, 等渲染线程 map PBO
+    kFilling,   // 工作线程往 PBO 里拷贝像素
+    kFilled,    // 拷贝完成, 等渲染线程上传
+    kReady,     // 真正的贴图已就绪
+    kFailed,    // 出错了, 继续用占位贴图
+  };
+
+  void Decode();
+  bool DecodeSource();
+  bool OpenTextureFile();
+  void Join();
+
+  std::string path_;
+  GLuint texture_id_;
+  size_t bytes_;
+  GLuint pbo_;
+  std::atomic<int> state_;
+  std::thread worker_;
+
+  // 工作线程与渲染线程交接 PBO 的映射地址
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  void* mapped_;
+  bool cancel_;
+
+  // 解码结果, 由工作线程写, kDecoded 之后渲染线程只读 levels_
+  // 数据要么在 chain_ 里 (刚解码的), 要么在 cache_ 的 mmap 里
+  MipCache cache_;
+  std::vector<unsigned char> chain_;
+  const unsigned char* chain_data_;
+  size_t chain_size_;
+  std::vector<MipLevel> levels_;
+  // 直接 mmap 的 .ktx2/.dds, 打开时跳过 PBO, kFilled 之后渲染线程直接读
+  TextureFile file_;
+
+  // 驱动支持哪些压缩格式, 渲染线程在 Load 里查好
+  bool format_supported_[3];
+  // 是否是压缩贴图, 以及它的格式, 由工作线程写
+  bool compressed_;
+  BlockFormat format_;
+};
+
+#endif  // GL_EARTH_TEXTURE_LOADER_H_
@@ -0,0 +1,92 @@
+#include "texture_manager.h"
+
+#include <cstdio>
+
+namespace {
+
+double Megabytes(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+}  // namespace
+
+const size_t TextureManager::kDefaultBudget;
+
+TextureManager::TextureManager(size_t budget_bytes)
+    : budget_(budget_bytes), resident_bytes_(0), frame_(0) {}
+
+TextureManager::Handle TextureManager::Add(const std::string& path) {
+  entries_.emplace_back();
+  Handle handle = static_cast<Handle>(entries_.size()) - 1;
+  entries_.back().path = path;
+  Use(handle);
+  return handle;
+}
+
+GLuint TextureManager::Use(Handle handle) {
+  if (handle < 0 || static_cast<size_t>(handle) >= entries_.size()) {
+    return 0;
+  }
+  Entry& entry = entries_[handle];
+  if (!entry.loaded) {
+    entry.texture.Load(entry.path);
+    entry.loaded = true;
+  }
+  entry.last_used = frame_;
+  return entry.texture.texture_id();
+}
+
+void TextureManager::Update() {
+  frame_++;
+  resident_bytes_ = 0;
+  for (Entry& entry : entries_) {
+    if (entry.loaded) {
+      entry.texture.Poll();
+      resident_bytes_ += entry.texture.bytes();
+    }
+  }
+  if (resident_bytes_ > budget_) {
+    Evict();
+  }
+}
+
+// 从最久没用的开始释放, 直到回到预算以内
+void TextureManager::Evict() {
+  while (resident_bytes_ > budget_) {
+    Entry* victim = NULL;
+    for (Entry& entry : entries_) {
+      // 还在载入的也可以淘汰, Release 会等工作线程退出
+      if (!entry.loaded || entry.last_used + 1 >= frame_) {
+        continue;
+      }
+      if (!victim || entry.last_used < victim->last_used) {
+        victim = &entry;
+      }
+    }
+    if (!victim) {
+      return;
+    }
+    size_t bytes = victim->texture.bytes();
+    victim->texture.Release();
+    victim->loaded = false;
+    resident_bytes_ -= bytes;
+    printf("[TextureManager] evict %s (%.1f MB), resident %.1f / %.1f MB\n",
+           victim->path.c_str(), Megabytes(bytes), Megabytes(resident_bytes_),
+           Megabytes(budget_));
+  }
+}
+
+void TextureManager::Release() {
+  for (Entry& entry : entries_) {
+    entry.texture.Release();
+    entry.loaded = false;
+  }
+  resident_bytes_ = 0;
+}
+
+bool TextureManager::settled() const {
+  for (const Entry& entry : entries_) {
+    if (entry.loaded && !entry.texture.settled()) {
+      return false;
+    }
+  }
+  return true;
+}
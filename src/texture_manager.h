@@ -0,0 +1,68 @@
+#ifndef GL_EARTH_TEXTURE_MANAGER_H_
+#define GL_EARTH_TEXTURE_MANAGER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "opengl.h"
+#include "texture_loader.h"
+
+/**
+ * 管理所有普通贴图 (AsyncTexture) 的显存
+ * 每张贴图就绪后记下它实际占的字节数, 总量超过预算时,
+ * 把最久没用过的贴图释放掉; 之后再用到时自动重新载入
+ * (有 mipmap 缓存或 DDS 时重新载入很快), 载入期间先用占位贴图
+ * 上一帧用到的贴图不会被淘汰, 所以预算太小时会超, 但不会来回抖
+ * 虚拟贴图的缓存是固定大小的, 不归这里管
+ */
+class TextureManager {
+ public:
+  typedef int Handle;
+
+  static const size_t kDefaultBudget = 256u << 20;
+
+  explicit TextureManager(size_t budget_bytes = kDefaultBudget);
+
+  // 登记一张贴图并开始载入, 需要在 GL context 创建之后调用
+  Handle Add(const std::string& path);
+
+  // 画之前调用, 返回要绑定的贴图 id, 没就绪时是占位贴图
+  // 已经被淘汰的会重新载入, 需要在渲染线程调用; 无效的 handle 返回 0
+  GLuint Use(Handle handle);
+
+  // 每帧开始时调用一次: 推进所有载入, 然后按预算淘汰
+  void Update();
+
+  // 释放所有贴图, 需要在 GL context 还有效时调用
+  void Release();
+
+  void set_budget(size_t bytes) { budget_ = bytes; }
+  size_t budget() const { return budget_; }
+  size_t resident_bytes() const { return resident_bytes_; }
+  // 用到的贴图都载入完了 (或者失败了)
+  bool settled() const;
+
+ private:
+  TextureManager(const TextureManager&) = delete;
+  TextureManager& operator=(const TextureManager&) = delete;
+
+  struct Entry {
+    Entry() : last_used(0), loaded(false) {}
+    std::string path;
+    AsyncTexture texture;
+    uint64_t last_used;  // 最近一次 Use 的帧号
+    bool loaded;         // 已经 Load 过, 还没被淘汰
+  };
+
+  void Evict();
+
+  // deque 扩容不会挪动已有元素, AsyncTexture 也不能挪
+  std::deque<Entry> entries_;
+  size_t budget_;
+  size_t resident_bytes_;
+  uint64_t frame_;
+};
+
+#endif  // GL_EARTH_TEXTURE_MANAGER_H_
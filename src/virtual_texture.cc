@@ -0,0 +1,667 @@
+#include "virtual_texture.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "image.h"
+#include "mesh.h"
+#include "mipmap.h"
+#include "shader.h"
+
+namespace {
+
+const int kTileSize = 128;  // tile 的有效像素
+const int kBorder = 1;      // 四周各 1 像素边框, 给双线性过滤用
+const int kMaxUploadsPerFrame = 8;
+
+// 占位格子 (slot 0) 的颜色, 与 AsyncTexture 的占位一致
+const GLubyte kPlaceholderPixel[4] = {26, 51, 102, 255};
+
+const char kMagic[4] = {'E', 'V', 'T', 'X'};
+const uint32_t kVersion = 1;
+
+// 金字塔文件头, 后面是 level_count 个 LevelEntry, 然后是所有 tile
+// 每个 tile 为 (tile_size + 2 * border)^2 个 RGBA8 像素
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tile_size;
+  uint32_t border;
+  uint32_t level_count;
+  uint32_t reserved;
+};
+
+struct LevelEntry {
+  uint32_t width;
+  uint32_t height;
+  uint32_t tiles_x;
+  uint32_t tiles_y;
+  uint64_t first_tile;
+};
+
+// 先查 page table 得到覆盖当前位置的、已在缓存里的最细一级 tile,
+// 再换算成物理缓存里的坐标
+const char kFragmentShader[] =
+    GL_EARTH_GLSL_VERSION
+    "uniform sampler2D page_table;\n"
+    "uniform sampler2D cache;\n"
+    "uniform vec2 virtual_size;\n"
+    "uniform vec2 page_table_size;\n"
+    "uniform float tile_size;\n"
+    "uniform float border;\n"
+    "uniform float slot_size;\n"
+    "uniform float cache_size;\n"
+    "in vec2 uv;\n"
+    "in vec4 tint;\n"
+    "out vec4 frag_color;\n"
+    "void main() {\n"
+    "  vec2 cell = clamp(floor(uv * virtual_size / tile_size), vec2(0.0),\n"
+    "                    page_table_size - 1.0);\n"
+    "  vec4 entry = floor(texture(page_table,\n"
+    "                             (cell + 0.5) / page_table_size) * 255.0 +\n"
+    "                     0.5);\n"
+    "  vec2 tile = uv * virtual_size / (tile_size * exp2(entry.b));\n"
+    "  vec2 texel = entry.rg * slot_size + border + fract(tile) * tile_size;\n"
+    "  frag_color = texture(cache, texel / cache_size) * tint;\n"
+    "}\n";
+
+// 一级里的第 t 个 tile (该级边长 size) 在下一级 (边长 finer) 里
+// 从哪个 tile 开始, 到哪个 tile 之前结束; 64k 的图乘起来会超过 int
+int FinerTile(int t, int size, int finer) {
+  return static_cast<int>(static_cast<int64_t>(t) * kTileSize * finer / size /
+                          kTileSize);
+}
+
+int FinerTileEnd(int t, int size, int finer) {
+  int64_t end = (static_cast<int64_t>(t) + 1) * kTileSize * finer / size;
+  return static_cast<int>((end + kTileSize - 1) / kTileSize);
+}
+
+}  // namespace
+
+VirtualTexture::VirtualTexture(int cache_slots)
+    : cache_slots_(cache_slots),
+      slot_size_(kTileSize + 2 * kBorder),
+      program_(0),
+      cache_texture_(0),
+      page_table_(0),
+      opened_(false),
+      failed_(false),
+      configured_(false),
+      fd_(-1),
+      width_(0),
+      height_(0),
+      frame_(0),
+      missing_(0),
+      quit_(false) {}
+
+VirtualTexture::~VirtualTexture() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  cond_.notify_one();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void VirtualTexture::Load(const std::string& path) {
+  Release();
+  path_ = path;
+
+  program_ =
+      CompileProgram("virtual texture", kMeshVertexShader, kFragmentShader);
+  if (!program_) {
+    // 和金字塔打不开一样, 让调用方退回普通贴图
+    failed_ = true;
+    return;
+  }
+
+  // 物理缓存, 没有 mipmap, 每个 tile 自带边框
+  int cache_size = cache_slots_ * slot_size_;
+  glGenTextures(1, &cache_texture_);
+  glBindTexture(GL_TEXTURE_2D, cache_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, cache_size, cache_size, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, NULL);
+
+  // slot 0 永远是占位色, 还没加载的地方都指向它
+  std::vector<GLubyte> placeholder(slot_size_ * slot_size_ * 4);
+  for (size_t i = 0; i < placeholder.size(); i += 4) {
+    memcpy(&placeholder[i], kPlaceholderPixel, 4);
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, slot_size_, slot_size_, GL_RGBA,
+                  GL_UNSIGNED_BYTE, placeholder.data());
+
+  // page table 先放 1x1, 金字塔打开之后再按 tile 数分配
+  GLubyte empty[4] = {0, 0, 0, 255};
+  glGenTextures(1, &page_table_);
+  glBindTexture(GL_TEXTURE_2D, page_table_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               empty);
+
+  glUseProgram(program_);
+  glUniform1i(glGetUniformLocation(program_, "cache"), 0);
+  glUniform1i(glGetUniformLocation(program_, "page_table"), 1);
+  glUniform2f(glGetUniformLocation(program_, "virtual_size"), 1.f, 1.f);
+  glUniform2f(glGetUniformLocation(program_, "page_table_size"), 1.f, 1.f);
+  glUniform1f(glGetUniformLocation(program_, "tile_size"), kTileSize);
+  glUniform1f(glGetUniformLocation(program_, "border"), kBorder);
+  glUniform1f(glGetUniformLocation(program_, "slot_size"), slot_size_);
+  glUniform1f(glGetUniformLocation(program_, "cache_size"), cache_size);
+  glUseProgram(0);
+
+  Slot empty_slot = {0, 0, false};
+  slots_.assign(cache_slots_ * cache_slots_, empty_slot);
+  slots_[0].used = true;  // 占位
+  quit_ = false;
+  worker_ = std::thread(&VirtualTexture::Run, this);
+}
+
+// 后台线程: 打开 (必要时先生成) 金字塔, 然后按请求读 tile
+void VirtualTexture::Run() {
+  if (!OpenPyramid()) {
+    printf("[VT] building tile pyramid for %s\n", path_.c_str());
+    if (!BuildPyramid() || !OpenPyramid()) {
+      fprintf(stderr, "[VT] open tile pyramid for %s failed %s:%d\n",
+              path_.c_str(), __FILE__, __LINE__);
+      failed_ = true;
+      return;
+    }
+  }
+  opened_ = true;
+
+  while (true) {
+    uint64_t key;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return quit_ || !requests_.empty(); });
+      if (quit_) {
+        return;
+      }
+      key = requests_.front();
+      requests_.pop_front();
+      in_flight_.insert(key);
+    }
+
+    LoadedTile tile;
+    tile.key = key;
+    bool ok = ReadTile(key, &tile.pixels);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ok) {
+      loaded_.push_back(std::move(tile));
+    } else {
+      in_flight_.erase(key);
+    }
+  }
+}
+
+bool VirtualTexture::OpenPyramid() {
+  uint64_t source_size;
+  int64_t source_mtime;
+  if (!FileStamp(path_, &source_size, &source_mtime)) {
+    return false;
+  }
+  int fd = open((path_ + ".vt").c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  FileHeader header;
+  if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      memcmp(header.magic, kMagic, 4) != 0 || header.version != kVersion ||
+      header.source_size != source_size ||
+      header.source_mtime != source_mtime ||
+      header.tile_size != static_cast<uint32_t>(kTileSize) ||
+      header.border != static_cast<uint32_t>(kBorder) ||
+      header.level_count == 0) {
+    close(fd);
+    return false;
+  }
+
+  std::vector<LevelEntry> entries(header.level_count);
+  ssize_t table_size = sizeof(LevelEntry) * entries.size();
+  if (pread(fd, entries.data(), table_size, sizeof(header)) != table_size) {
+    close(fd);
+    return false;
+  }
+  levels_.clear();
+  for (const LevelEntry& entry : entries) {
+    Level level = {static_cast<int>(entry.width),
+                   static_cast<int>(entry.height),
+                   static_cast<int>(entry.tiles_x),
+                   static_cast<int>(entry.tiles_y), entry.first_tile};
+    levels_.push_back(level);
+  }
+  width_ = header.width;
+  height_ = header.height;
+  fd_ = fd;
+  return true;
+}
+
+// 切 tile
+// 需要完整解码源图和 mipmap 链, 内存受解码器限制,
+// 但运行时只读 tile, 与源图大小无关
+bool VirtualTexture::BuildPyramid() {
+  std::vector<unsigned char> base;
+  int width;
+  int height;
+  if (!DecodeImage(path_, std::thread::hardware_concurrency(), &base, &width,
+                   &height)) {
+    return false;
+  }
+  std::vector<unsigned char> chain;
+  std::vector<MipLevel> mips;
+  BuildMipChain(base.data(), width, height,
+                std::thread::hardware_concurrency(), &chain, &mips);
+  std::vector<unsigned char>().swap(base);
+
+  // 一直切到整级只剩一个 tile
+  std::vector<LevelEntry> entries;
+  uint64_t tile_count = 0;
+  for (const MipLevel& mip : mips) {
+    LevelEntry entry = {static_cast<uint32_t>(mip.width),
+                        static_cast<uint32_t>(mip.height),
+                        static_cast<uint32_t>((mip.width + kTileSize - 1) /
+                                              kTileSize),
+                        static_cast<uint32_t>((mip.height + kTileSize - 1) /
+                                              kTileSize),
+                        tile_count};
+    entries.push_back(entry);
+    tile_count += static_cast<uint64_t>(entry.tiles_x) * entry.tiles_y;
+    if (entry.tiles_x == 1 && entry.tiles_y == 1) {
+      break;
+    }
+  }
+
+  FileHeader header;
+  memcpy(header.magic, kMagic, 4);
+  header.version = kVersion;
+  if (!FileStamp(path_, &header.source_size, &header.source_mtime)) {
+    return false;
+  }
+  header.width = width;
+  header.height = height;
+  header.tile_size = kTileSize;
+  header.border = kBorder;
+  header.level_count = static_cast<uint32_t>(entries.size());
+  header.reserved = 0;
+
+  std::string path = path_ + ".vt";
+  std::string tmp = path + ".tmp";
+  FILE* fp = fopen(tmp.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(entries.data(), sizeof(LevelEntry), entries.size(), fp) ==
+                entries.size();
+
+  // 经度方向 (x) 首尾相接, 边框取对面的像素; 纬度方向 (y) 取边上的像素
+  std::vector<unsigned char> tile(slot_size_ * slot_size_ * 4);
+  for (size_t l = 0; ok && l < entries.size(); l++) {
+    const MipLevel& mip = mips[l];
+    const unsigned char* px = chain.data() + mip.offset;
+    for (uint32_t ty = 0; ok && ty < entries[l].tiles_y; ty++) {
+      for (uint32_t tx = 0; ok && tx < entries[l].tiles_x; tx++) {
+        for (int sy = 0; sy < slot_size_; sy++) {
+          int y = std::min(std::max(static_cast<int>(ty) * kTileSize + sy -
+                                        kBorder,
+                                    0),
+                           mip.height - 1);
+          for (int sx = 0; sx < slot_size_; sx++) {
+            int x = static_cast<int>(tx) * kTileSize + sx - kBorder;
+            x = ((x % mip.width) + mip.width) % mip.width;
+            memcpy(&tile[(sy * slot_size_ + sx) * 4],
+                   px + (static_cast<size_t>(y) * mip.width + x) * 4, 4);
+          }
+        }
+        ok = fwrite(tile.data(), 1, tile.size(), fp) == tile.size();
+      }
+    }
+  }
+  ok = fclose(fp) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool VirtualTexture::ReadTile(uint64_t key,
+                              std::vector<unsigned char>* pixels) {
+  int level = static_cast<int>(key >> 48);
+  int ty = static_cast<int>((key >> 24) & 0xffffff);
+  int tx = static_cast<int>(key & 0xffffff);
+  const Level& l = levels_[level];
+  size_t tile_bytes = static_cast<size_t>(slot_size_) * slot_size_ * 4;
+  uint64_t index = l.first_tile + static_cast<uint64_t>(ty) * l.tiles_x + tx;
+  off_t offset = sizeof(FileHeader) + sizeof(LevelEntry) * levels_.size() +
+                 index * tile_bytes;
+  pixels->resize(tile_bytes);
+  return pread(fd_, pixels->data(), tile_bytes, offset) ==
+         static_cast<ssize_t>(tile_bytes);
+}
+
+// tile 在单位球上是一块经纬度矩形, 用包住它的球冠判断:
+// 球冠的角半径 α 取中心沿经线再沿纬线走到四角的路程, 总是够大;
+// 球冠和视锥求交, 再用法线锥剔掉背面的
+bool VirtualTexture::TileVisible(const Level& level, int tx, int ty,
+                                 const Frustum& frustum,
+                                 const glm::vec3& view_dir) const {
+  float v0 = static_cast<float>(ty * kTileSize) / level.height;
+  float v1 =
+      std::min(static_cast<float>((ty + 1) * kTileSize) / level.height, 1.f);
+  float u0 = static_cast<float>(tx * kTileSize) / level.width;
+  float u1 =
+      std::min(static_cast<float>((tx + 1) * kTileSize) / level.width, 1.f);
+  float lat = M_PI / 2 - (v0 + v1) / 2 * M_PI;
+  float lon = (u0 + u1) / 2 * 2 * M_PI - M_PI;
+  float angle = std::min((v1 - v0) / 2 * M_PI + (u1 - u0) * M_PI, M_PI);
+  // tile 中心的方向, 与 BuildUvSphere 的参数化一致
+  glm::vec3 n(std::cos(lat) * std::sin(lon), std::sin(lat),
+              std::cos(lat) * std::cos(lon));
+  float cos_angle = std::cos(angle);
+  float sin_angle = std::sin(angle);
+  // 球冠整个在背面: 法线与观察方向的夹角都超过 90°
+  if (angle < M_PI / 2 && glm::dot(n, view_dir) <= -sin_angle) {
+    return false;
+  }
+  return CapVisible(frustum, n, cos_angle, sin_angle);
+}
+
+// 需要哪些 tile
+// 从最粗的一级往下走, 只走进视锥里而且朝着观察者的 tile,
+// 一个 texel 投到屏幕上还超过 1 像素的才往下一级细分;
+// 所以要看的 tile 数只和屏幕大小有关, 和源图多大, 放大多少倍无关
+// 最细的一级和最粗的一级 (哪里都有东西可画) 一定要, 中间各级是载入时的后备,
+// 缓存放不下时从细往粗丢掉; 粗的在前, 优先加载
+void VirtualTexture::CollectTiles(const Frustum& frustum,
+                                  const glm::vec3& view_dir, float extent,
+                                  std::vector<uint64_t>* wanted) const {
+  int level_count = static_cast<int>(levels_.size());
+  size_t capacity = cache_slots_ * cache_slots_ - 1;
+
+  // 每一级看得见的 tile, 粗的在前
+  std::vector<std::vector<uint64_t> > selected;
+  // 这一级要看的 tile, (tx, ty)
+  std::vector<std::pair<int, int> > tiles;
+  std::vector<std::pair<int, int> > children;
+  const Level& top = levels_[level_count - 1];
+  for (int ty = 0; ty < top.tiles_y; ty++) {
+    for (int tx = 0; tx < top.tiles_x; tx++) {
+      tiles.push_back(std::make_pair(tx, ty));
+    }
+  }
+  for (int l = level_count - 1; l >= 0 && !tiles.empty(); l--) {
+    const Level& level = levels_[l];
+    bool coarsest = l == level_count - 1;
+    // 经线方向一个 texel 在单位球上的长度, 纬线方向的只会更短
+    bool refine = l > 0 && extent * M_PI / level.height > 1.f;
+    std::vector<uint64_t> keys;
+    children.clear();
+    for (const std::pair<int, int>& tile : tiles) {
+      int tx = tile.first;
+      int ty = tile.second;
+      if (!coarsest && !TileVisible(level, tx, ty, frustum, view_dir)) {
+        continue;
+      }
+      keys.push_back(TileKey(l, tx, ty));
+      if (!refine) {
+        continue;
+      }
+      // 下一级里和这个 tile 重叠的 tile; 宽高不一定正好翻倍, 按像素范围算
+      const Level& finer = levels_[l - 1];
+      int x0 = FinerTile(tx, level.width, finer.width);
+      int x1 = std::min(FinerTileEnd(tx, level.width, finer.width),
+                        finer.tiles_x);
+      int y0 = FinerTile(ty, level.height, finer.height);
+      int y1 = std::min(FinerTileEnd(ty, level.height, finer.height),
+                        finer.tiles_y);
+      for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+          children.push_back(std::make_pair(x, y));
+        }
+      }
+    }
+    // 这一级加上最粗的一级都放不下, 就停在上一级
+    if (!coarsest && keys.size() + selected[0].size() > capacity) {
+      break;
+    }
+    selected.push_back(keys);
+    // 相邻的 tile 会把同一个孩子加两次
+    std::sort(children.begin(), children.end());
+    children.erase(std::unique(children.begin(), children.end()),
+                   children.end());
+    tiles.swap(children);
+  }
+
+  // 先留出最细一级的位置, 剩下的从粗到细给中间各级
+  wanted->clear();
+  size_t finest = selected.size() - 1;
+  size_t budget = capacity - selected[finest].size();
+  for (size_t i = 0; i < finest; i++) {
+    if (selected[i].size() > budget) {
+      break;
+    }
+    budget -= selected[i].size();
+    wanted->insert(wanted->end(), selected[i].begin(), selected[i].end());
+  }
+  wanted->insert(wanted->end(), selected[finest].begin(),
+                 selected[finest].end());
+}
+
+void VirtualTexture::Update(const glm::mat4& model, const glm::mat4& view,
+                            const glm::mat4& projection, int width,
+                            int height) {
+  if (!program_ || !opened_) {
+    return;
+  }
+  frame_++;
+
+  if (!configured_) {
+    const Level& base = levels_[0];
+    page_entries_.assign(base.tiles_x * base.tiles_y * 4, 0);
+    glBindTexture(GL_TEXTURE_2D, page_table_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, base.tiles_x, base.tiles_y, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glUseProgram(program_);
+    glUniform2f(glGetUniformLocation(program_, "virtual_size"), width_,
+                height_);
+    glUniform2f(glGetUniformLocation(program_, "page_table_size"),
+                base.tiles_x, base.tiles_y);
+    glUseProgram(0);
+    configured_ = true;
+    RebuildPageTable();
+  }
+
+  // 和 GlobeQuadtree 一样, 视锥和观察方向都换到球的模型空间里
+  glm::mat4 mvp = projection * view * model;
+  Frustum frustum = ExtractFrustum(mvp);
+  glm::vec3 view_dir = glm::normalize(glm::inverse(glm::mat3(view * model)) *
+                                      glm::vec3(0.f, 0.f, 1.f));
+  float extent =
+      std::max(glm::length(glm::vec3(mvp[0][0], mvp[1][0], mvp[2][0])) * width,
+               glm::length(glm::vec3(mvp[0][1], mvp[1][1], mvp[2][1])) *
+                   height) /
+      2.f;
+  std::vector<uint64_t> wanted;
+  CollectTiles(frustum, view_dir, extent, &wanted);
+
+  bool changed = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 请求队列每帧重建, 视角变了之后过时的请求就不读了
+    requests_.clear();
+    missing_ = 0;
+    for (uint64_t key : wanted) {
+      std::unordered_map<uint64_t, int>::const_iterator it =
+          resident_.find(key);
+      if (it != resident_.end()) {
+        slots_[it->second].last_used = frame_;
+        continue;
+      }
+      missing_++;
+      if (!in_flight_.count(key)) {
+        requests_.push_back(key);
+      }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, cache_texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (int n = 0; n < kMaxUploadsPerFrame && !loaded_.empty(); n++) {
+      LoadedTile& tile = loaded_.front();
+      int slot = AllocateSlot();
+      if (slot < 0) {
+        // 缓存满了, 而且都是这一帧要用的, 下一帧再说
+        break;
+      }
+      if (slots_[slot].used) {
+        resident_.erase(slots_[slot].key);
+      }
+      slots_[slot].key = tile.key;
+      slots_[slot].last_used = frame_;
+      slots_[slot].used = true;
+      resident_[tile.key] = slot;
+      glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % cache_slots_) * slot_size_,
+                      (slot / cache_slots_) * slot_size_, slot_size_,
+                      slot_size_, GL_RGBA, GL_UNSIGNED_BYTE,
+                      tile.pixels.data());
+      in_flight_.erase(tile.key);
+      loaded_.pop_front();
+      changed = true;
+    }
+  }
+  cond_.notify_one();
+
+  if (changed) {
+    RebuildPageTable();
+  }
+}
+
+// LRU: 先找空格子, 没有就找最久没用的
+// 这一帧要用的和最粗一级 (后备) 的 tile 不淘汰
+int VirtualTexture::AllocateSlot() {
+  int coarsest = static_cast<int>(levels_.size()) - 1;
+  int best = -1;
+  for (int i = 1; i < static_cast<int>(slots_.size()); i++) {
+    const Slot& slot = slots_[i];
+    if (!slot.used) {
+      return i;
+    }
+    if (slot.last_used == frame_ ||
+        static_cast<int>(slot.key >> 48) == coarsest) {
+      continue;
+    }
+    if (best < 0 || slot.last_used < slots_[best].last_used) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// page table 的每个格子对应第 0 级的一个 tile,
+// 记录覆盖它的、已在缓存里的最细一级 tile: (slot x, slot y, level)
+// 从粗到细依次覆盖, 细的盖住粗的
+void VirtualTexture::RebuildPageTable() {
+  const Level& base = levels_[0];
+  std::fill(page_entries_.begin(), page_entries_.end(), 0);
+
+  std::vector<std::pair<uint64_t, int> > tiles(resident_.begin(),
+                                               resident_.end());
+  std::sort(tiles.begin(), tiles.end(),
+            [](const std::pair<uint64_t, int>& a,
+               const std::pair<uint64_t, int>& b) {
+              return a.first > b.first;
+            });
+  for (const std::pair<uint64_t, int>& tile : tiles) {
+    int level = static_cast<int>(tile.first >> 48);
+    int ty = static_cast<int>((tile.first >> 24) & 0xffffff);
+    int tx = static_cast<int>(tile.first & 0xffffff);
+    GLubyte entry[4] = {static_cast<GLubyte>(tile.second % cache_slots_),
+                        static_cast<GLubyte>(tile.second / cache_slots_),
+                        static_cast<GLubyte>(level), 255};
+    int x1 = std::min((tx + 1) << level, base.tiles_x);
+    int y1 = std::min((ty + 1) << level, base.tiles_y);
+    for (int y = ty << level; y < y1; y++) {
+      for (int x = tx << level; x < x1; x++) {
+        memcpy(&page_entries_[(y * base.tiles_x + x) * 4], entry, 4);
+      }
+    }
+  }
+
+  glBindTexture(GL_TEXTURE_2D, page_table_);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, base.tiles_x, base.tiles_y, GL_RGBA,
+                  GL_UNSIGNED_BYTE, page_entries_.data());
+}
+
+void VirtualTexture::Bind(const glm::mat4& model) const {
+  glUseProgram(program_);
+  glUniformMatrix4fv(glGetUniformLocation(program_, "model"), 1, GL_FALSE,
+                     glm::value_ptr(model));
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, page_table_);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, cache_texture_);
+}
+
+void VirtualTexture::Unbind() const { glUseProgram(0); }
+
+void VirtualTexture::Release() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+    requests_.clear();
+    in_flight_.clear();
+    loaded_.clear();
+  }
+  cond_.notify_one();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  if (program_) {
+    glDeleteProgram(program_);
+    glDeleteTextures(1, &cache_texture_);
+    glDeleteTextures(1, &page_table_);
+  }
+  program_ = cache_texture_ = page_table_ = 0;
+  opened_ = false;
+  failed_ = false;
+  configured_ = false;
+  missing_ = 0;
+  levels_.clear();
+  slots_.clear();
+  resident_.clear();
+  page_entries_.clear();
+}
@@ -0,0 +1,143 @@
+#ifndef GL_EARTH_VIRTUAL_TEXTURE_H_
+#define GL_EARTH_VIRTUAL_TEXTURE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "opengl.h"
+
+/**
+ * 虚拟贴图 (virtual texture)
+ * 16k ~ 64k 的等距圆柱投影地图没法作为一张贴图上传,
+ * 于是把源图切成带边框的 tile, 每一级 mipmap 都切, 存在源图旁边 (xxx.vt)
+ * 每帧从粗到细走 tile 金字塔, 只走视锥里朝着观察者的 tile,
+ * texel 投到屏幕上比像素大的才往细一级走, 这样算出需要哪些 tile,
+ * 由后台线程读盘, 放进固定大小的物理缓存贴图 (LRU 淘汰)
+ * fragment shader 通过一张间接贴图 (page table) 找到 tile 在缓存里的位置
+ * 这样不管源图多大, 显存占用都是固定的
+ */
+class VirtualTexture {
+ public:
+  // cache_slots 为物理缓存每边的 tile 数
+  explicit VirtualTexture(int cache_slots = 16);
+  ~VirtualTexture();
+
+  // 创建缓存贴图和 shader, 启动后台线程 (打开或生成 tile 金字塔)
+  // 需要在 GL context 创建之后调用
+  void Load(const std::string& path);
+
+  // 每帧在渲染线程调用一次
+  // model 为球的模型矩阵 (单位球), width, height 为 viewport 的像素大小
+  void Update(const glm::mat4& model, const glm::mat4& view,
+              const glm::mat4& projection, int width, int height);
+
+  // 画球之前 Bind, 之后 Unbind
+  // model 为球的模型矩阵
+  void Bind(const glm::mat4& model) const;
+  void Unbind() const;
+
+  // 释放显存和线程, 需要在 GL context 还有效时调用
+  void Release();
+
+  bool loaded() const { return program_ != 0; }
+  // shader 编译失败, 或者后台线程打不开也生成不了金字塔,
+  // 调用方应该 Release 掉改用普通贴图
+  bool failed() const { return failed_; }
+  const std::string& path() const { return path_; }
+  // 上一次 Update 需要的 tile 是否都已经在缓存里了
+  // 没启用虚拟贴图或者已经失败时总是 true
+  bool settled() const {
+    return !program_ || failed_ || (configured_ && missing_ == 0);
+  }
+
+ private:
+  VirtualTexture(const VirtualTexture&) = delete;
+  VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+  struct Level {
+    int width;
+    int height;
+    int tiles_x;
+    int tiles_y;
+    uint64_t first_tile;  // 在文件里的 tile 序号
+  };
+
+  // 物理缓存的一个格子
+  struct Slot {
+    uint64_t key;
+    uint64_t last_used;  // 最近一次被需要的帧号
+    bool used;
+  };
+
+  struct LoadedTile {
+    uint64_t key;
+    std::vector<unsigned char> pixels;
+  };
+
+  static uint64_t TileKey(int level, int tx, int ty) {
+    return (static_cast<uint64_t>(level) << 48) |
+           (static_cast<uint64_t>(ty) << 24) | static_cast<uint64_t>(tx);
+  }
+
+  // 后台线程
+  void Run();
+  bool OpenPyramid();
+  bool BuildPyramid();
+  bool ReadTile(uint64_t key, std::vector<unsigned char>* pixels);
+
+  // 渲染线程
+  // frustum 和 view_dir 在球的模型空间里,
+  // extent 为模型空间一个单位投到屏幕上的像素数
+  void CollectTiles(const Frustum& frustum, const glm::vec3& view_dir,
+                    float extent, std::vector<uint64_t>* wanted) const;
+  bool TileVisible(const Level& level, int tx, int ty, const Frustum& frustum,
+                   const glm::vec3& view_dir) const;
+  int AllocateSlot();
+  void RebuildPageTable();
+
+  std::string path_;
+  int cache_slots_;
+  int slot_size_;
+
+  GLuint program_;
+  GLuint cache_texture_;
+  GLuint page_table_;
+
+  // tile 金字塔, 后台线程打开后 (opened_ 为 true) 只读
+  std::atomic<bool> opened_;
+  std::atomic<bool> failed_;  // 后台线程放弃了, 不会再有 tile
+  bool configured_;  // 渲染线程是否已按金字塔分配好 page table
+  int fd_;
+  int width_;
+  int height_;
+  std::vector<Level> levels_;
+
+  // 渲染线程的缓存状态
+  uint64_t frame_;
+  size_t missing_;  // 上一次 Update 时还不在缓存里的 tile 数
+  std::vector<Slot> slots_;
+  std::unordered_map<uint64_t, int> resident_;  // tile -> slot
+  std::vector<unsigned char> page_entries_;
+
+  // 与后台线程之间的请求/结果队列
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<uint64_t> requests_;
+  std::set<uint64_t> in_flight_;
+  std::deque<LoadedTile> loaded_;
+  bool quit_;
+  std::thread worker_;
+};
+
+#endif  // GL_EARTH_VIRTUAL_TEXTURE_H_